@@ -0,0 +1,212 @@
+/************************************************************
+ * Throughput of the simulation kernels (Google Benchmark).
+ *
+ * Every benchmark reports items per second in the unit of its
+ * kernel: samples/s for the pi estimators, steps/s for the
+ * random walk and the Markov chains (over a range of state
+ * counts), arrivals/s for the Poisson generators and events/s
+ * for the processor-sharing DES. Inputs and streams are fixed,
+ * so two runs do the same work and only the timing differs.
+ *
+ * Build with CMake (target kernel_benchmarks). Compare a run
+ * with the checked-in baseline:
+ *   cmake --build build --target bench_compare
+ ************************************************************/
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "Common/RandomStreams.hpp"
+#include "Continuous-timeStochasticProcesses/PoissonProcess.hpp"
+#include "Discrete-Event Simulation/FES.hpp"
+#include "Discrete-timeStochasticProcesses/MarkovChains.hpp"
+#include "Discrete-timeStochasticProcesses/RandomWalks.hpp"
+#include "MonteCarlo/EstimatorOfPi.hpp"
+
+namespace
+{
+constexpr std::uint64_t SEED = 12345;
+constexpr long long PI_SAMPLES = 1 << 22;
+constexpr long long WALK_STEPS = 1 << 22;
+constexpr int CHAIN_STEPS = 1 << 20;
+constexpr double POISSON_HORIZON = 1e6;
+
+// ---- Monte Carlo: samples/s ----
+
+void BM_PiScalar(benchmark::State &state)
+{
+    Xoshiro256StarStar rng = makeStream(SEED, 0);
+    for (auto _ : state) benchmark::DoNotOptimize(countInsideCircle(rng, PI_SAMPLES));
+    state.SetItemsProcessed(state.iterations() * PI_SAMPLES);
+}
+BENCHMARK(BM_PiScalar);
+
+void BM_PiBatched(benchmark::State &state)
+{
+    PiLanes lanes(makeStream(SEED, 0));
+    for (auto _ : state) benchmark::DoNotOptimize(countInsideCircleBatched(lanes, PI_SAMPLES));
+    state.SetItemsProcessed(state.iterations() * PI_SAMPLES);
+}
+BENCHMARK(BM_PiBatched);
+
+// ---- Random walks: steps/s ----
+
+void BM_RandomWalk(benchmark::State &state)
+{
+    Xoshiro256StarStar rng = makeStream(SEED, 0);
+    for (auto _ : state)
+    {
+        long long sum = 0;
+        simRandomWalk(0.5, WALK_STEPS, rng, [&sum](long long, long long position) { sum += position; });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * WALK_STEPS);
+}
+BENCHMARK(BM_RandomWalk);
+
+void BM_RandomWalkStatsFast(benchmark::State &state)
+{
+    Xoshiro256StarStar rng = makeStream(SEED, 0);
+    for (auto _ : state) benchmark::DoNotOptimize(simRandomWalkStatsFast(0.5, WALK_STEPS, 100, rng));
+    state.SetItemsProcessed(state.iterations() * WALK_STEPS);
+}
+BENCHMARK(BM_RandomWalkStatsFast);
+
+// ---- Markov chains: steps/s against the number of states ----
+
+// Dense k x k matrix with random positive rows.
+std::vector<std::vector<double>> randomMatrix(int k)
+{
+    Xoshiro256StarStar rng = makeStream(SEED, 1);
+    std::uniform_real_distribution<double> U(0.1, 1.0);
+    std::vector<std::vector<double>> p(k, std::vector<double>(k));
+    for (auto &row : p)
+    {
+        double sum = 0.0;
+        for (double &v : row) sum += (v = U(rng));
+        for (double &v : row) v /= sum;
+    }
+    return p;
+}
+
+// Sparse chain on k states with 'degree' random successors per state.
+SparseAliasTransitions randomSparseChain(int k, int degree)
+{
+    Xoshiro256StarStar rng = makeStream(SEED, 2);
+    std::uniform_int_distribution<int> state(0, k - 1);
+    std::uniform_real_distribution<double> U(0.1, 1.0);
+    std::vector<Transition> entries;
+    entries.reserve(static_cast<std::size_t>(k) * degree);
+    for (int i = 0; i < k; i++)
+        for (int d = 0; d < degree; d++) entries.push_back({i, state(rng), U(rng)});
+    return SparseAliasTransitions(k, std::move(entries));
+}
+
+void BM_MarkovChainDense(benchmark::State &state)
+{
+    AliasTransitions p(randomMatrix(static_cast<int>(state.range(0))));
+    Xoshiro256StarStar rng = makeStream(SEED, 0);
+    for (auto _ : state) benchmark::DoNotOptimize(simMarkovChain(p, 0, CHAIN_STEPS, rng));
+    state.SetItemsProcessed(state.iterations() * CHAIN_STEPS);
+}
+BENCHMARK(BM_MarkovChainDense)->RangeMultiplier(8)->Range(2, 2048);
+
+void BM_MarkovChainSparse(benchmark::State &state)
+{
+    SparseAliasTransitions p = randomSparseChain(static_cast<int>(state.range(0)), 8);
+    Xoshiro256StarStar rng = makeStream(SEED, 0);
+    for (auto _ : state) benchmark::DoNotOptimize(simMarkovChain(p, 0, CHAIN_STEPS, rng));
+    state.SetItemsProcessed(state.iterations() * CHAIN_STEPS);
+}
+BENCHMARK(BM_MarkovChainSparse)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+// Building the alias tables, per matrix entry.
+void BM_MarkovChainSetup(benchmark::State &state)
+{
+    const int k = static_cast<int>(state.range(0));
+    std::vector<std::vector<double>> p = randomMatrix(k);
+    for (auto _ : state) benchmark::DoNotOptimize(AliasTransitions(p));
+    state.SetItemsProcessed(state.iterations() * k * k);
+}
+BENCHMARK(BM_MarkovChainSetup)->RangeMultiplier(8)->Range(8, 2048);
+
+// ---- Poisson processes: arrivals/s ----
+
+void BM_PoissonHomogeneous(benchmark::State &state)
+{
+    const PoissonMethod method = static_cast<PoissonMethod>(state.range(0));
+    Xoshiro256StarStar rng = makeStream(SEED, 0);
+    long long arrivals = 0;
+    for (auto _ : state)
+    {
+        std::vector<double> times = simulateHomogeneousPoisson(1.0, POISSON_HORIZON, rng, method);
+        arrivals += static_cast<long long>(times.size());
+        benchmark::DoNotOptimize(times.data());
+    }
+    state.SetItemsProcessed(arrivals);
+}
+BENCHMARK(BM_PoissonHomogeneous)
+    ->Arg(static_cast<int>(PoissonMethod::Exponential))
+    ->Arg(static_cast<int>(PoissonMethod::OrderStatistics));
+
+// lambda(t) = 2 + 2 sin(0.1 pi t) of PoissonProcess.cpp, thinned from lambdaMax = 4.
+void BM_PoissonNonHomogeneous(benchmark::State &state)
+{
+    auto rate = [](double t) { return 2.0 + 2.0 * std::sin(0.1 * 3.14159265358979323846 * t); };
+    Xoshiro256StarStar rng = makeStream(SEED, 0);
+    std::vector<double> times;
+    long long arrivals = 0;
+    for (auto _ : state)
+    {
+        simulateNonHomogeneousPoisson(rate, 4.0, POISSON_HORIZON / 2, rng, times);
+        arrivals += static_cast<long long>(times.size());
+        benchmark::DoNotOptimize(times.data());
+    }
+    state.SetItemsProcessed(arrivals);
+}
+BENCHMARK(BM_PoissonNonHomogeneous);
+
+void BM_PoissonCompound(benchmark::State &state)
+{
+    Xoshiro256StarStar rng = makeStream(SEED, 0);
+    std::normal_distribution<double> jump(0.0, 1.0);
+    long long arrivals = 0;
+    for (auto _ : state)
+    {
+        auto path = simulateCompoundPoisson(1.0, POISSON_HORIZON, rng, [&jump](Xoshiro256StarStar &r) { return jump(r); });
+        arrivals += static_cast<long long>(path.size());
+        benchmark::DoNotOptimize(path.data());
+    }
+    state.SetItemsProcessed(arrivals);
+}
+BENCHMARK(BM_PoissonCompound);
+
+// ---- Discrete-event simulation: events/s ----
+
+// M/M/1-PS with mu = 0.9 at load range(0) percent, in the departure
+// bookkeeping range(1) (0 = rescaling, 1 = virtual clock).
+void BM_ProcessorSharing(benchmark::State &state)
+{
+    const double mu = 0.9;
+    std::exponential_distribution<double> arrivals(state.range(0) / 100.0 * mu), services(mu);
+    auto sim = makeProcessorSharingSimulation([&](Xoshiro256StarStar &r) { return arrivals(r); },
+                                              [&](Xoshiro256StarStar &r) { return services(r); });
+    const PSMode mode = state.range(1) == 0 ? PSMode::Rescale : PSMode::VirtualTime;
+    long long events = 0;
+    for (auto _ : state)
+    {
+        Xoshiro256StarStar rng = makeStream(SEED, 0);
+        SimResults results = sim.simulate(1e5, rng, false, mode);
+        events += results.events();
+        benchmark::DoNotOptimize(results);
+    }
+    state.SetItemsProcessed(events);
+}
+BENCHMARK(BM_ProcessorSharing)->ArgsProduct({{70, 98}, {0, 1}});
+} // namespace
+
+BENCHMARK_MAIN();
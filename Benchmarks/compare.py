@@ -0,0 +1,84 @@
+"""Compare a Google Benchmark JSON run with the checked-in baseline.
+
+    python3 compare.py baseline.json benchmarks.json [--tolerance 0.10]
+    python3 compare.py baseline.json benchmarks.json --update
+
+Throughput is items per second (samples, steps, arrivals or events). With
+repetitions the best one is used: other load on the machine only ever
+slows a repetition down, so the fastest is the most stable estimate.
+Prints one line per benchmark and exits with status 1 if any benchmark is
+more than 'tolerance' slower than its baseline, so the comparison can gate
+a commit. --update rewrites the baseline from the run instead; commit it
+together with the change that moved the numbers. Baselines are only
+comparable on the same machine.
+"""
+import argparse
+import json
+import sys
+
+
+def throughput(path):
+    """Benchmark name -> items/s of a Google Benchmark JSON file or a baseline."""
+    with open(path) as f:
+        data = json.load(f)
+    if isinstance(data.get("benchmarks"), dict):
+        return data["benchmarks"], data.get("context", {})
+
+    rates = {}
+    for b in data["benchmarks"]:
+        if "items_per_second" not in b or b.get("run_type") == "aggregate":
+            continue
+        name = b.get("run_name", b["name"])
+        rates[name] = max(rates.get(name, 0.0), b["items_per_second"])
+    return rates, data.get("context", {})
+
+
+def write_baseline(path, rates, context):
+    keep = ("host_name", "num_cpus", "mhz_per_cpu", "library_build_type")
+    baseline = {"context": {k: context[k] for k in keep if k in context},
+                "benchmarks": {name: round(rate, 1) for name, rate in sorted(rates.items())}}
+    with open(path, "w") as f:
+        json.dump(baseline, f, indent=2)
+        f.write("\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--tolerance", type=float, default=0.10,
+                        help="relative slowdown reported as a regression (default 0.10)")
+    parser.add_argument("--update", action="store_true", help="overwrite the baseline with the current run")
+    args = parser.parse_args()
+
+    current, context = throughput(args.current)
+    if args.update:
+        write_baseline(args.baseline, current, context)
+        print(f"wrote {len(current)} baselines to {args.baseline}")
+        return 0
+
+    baseline, _ = throughput(args.baseline)
+    regressions = 0
+    width = max(len(name) for name in current) if current else 0
+    for name in sorted(current):
+        rate = current[name]
+        if name not in baseline:
+            print(f"{name:<{width}}  {rate / 1e6:10.2f} M/s  (new)")
+            continue
+        ratio = rate / baseline[name]
+        flag = ""
+        if ratio < 1.0 - args.tolerance:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<{width}}  {rate / 1e6:10.2f} M/s  {ratio:6.2f}x baseline{flag}")
+    for name in sorted(set(baseline) - set(current)):
+        print(f"{name:<{width}}  (missing from this run)")
+
+    if regressions:
+        print(f"{regressions} benchmark(s) more than {args.tolerance:.0%} slower than the baseline")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
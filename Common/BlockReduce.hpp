@@ -0,0 +1,280 @@
+/************************************************************
+ * Reductions over blocks that give the same bits however the
+ * blocks are divided over threads, processes or nodes.
+ *
+ * Floating-point merges are not associative, so merging the
+ * same blocks in a different grouping changes the last digits
+ * of a mean or variance. BlockTree fixes the grouping: the
+ * result over blocks 0..nBlocks-1 is always the pairwise merge
+ * along the binary tree whose level-L nodes cover the aligned
+ * ranges [i 2^L, (i+1) 2^L). Blocks (and whole subtrees) can be
+ * inserted in any order and by any party; a node is merged
+ * with its sibling as soon as both are present, so a contiguous
+ * range of blocks is held as O(log nBlocks) subtrees, and two
+ * partial trees over disjoint ranges absorb each other.
+ *
+ *  - blockRange: the contiguous share of part k of n
+ *  - StateWriter / StateReader: a minimal byte archive for the
+ *    accumulators' serialize(archive, version) members (the
+ *    same interface as Boost.Serialization)
+ *  - BlockTree<Stats>: the canonical merge, serializable
+ *  - runBlockRange: blocks [first, last) on nThreads threads,
+ *    block b on streams b * streamsPerBlock .. of 'seed'
+ *
+ * Stats needs merge(const Stats &), and serialize() to be sent
+ * between processes (Common/Distributed.hpp).
+ ************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "RandomStreams.hpp"
+
+// Blocks [first, last) of part 'part' when nBlocks are split over nParts
+// contiguous shares whose sizes differ by at most one.
+inline std::pair<long long, long long> blockRange(long long nBlocks, int part, int nParts)
+{
+    return {nBlocks * part / nParts, nBlocks * (part + 1) / nParts};
+}
+
+// Appends the raw bytes of numbers, strings and vectors of them; objects
+// with a serialize(archive, version) member are written through it.
+class StateWriter
+{
+public:
+    template <class T>
+    StateWriter &operator&(const T &value)
+    {
+        if constexpr (std::is_arithmetic<T>::value || std::is_enum<T>::value)
+        {
+            const unsigned char *raw = reinterpret_cast<const unsigned char *>(&value);
+            data.insert(data.end(), raw, raw + sizeof(T));
+        }
+        else
+        {
+            const_cast<T &>(value).serialize(*this, 0u);
+        }
+        return *this;
+    }
+
+    template <class T>
+    StateWriter &operator&(const std::vector<T> &values)
+    {
+        *this & static_cast<std::uint64_t>(values.size());
+        for (const T &v : values) *this & v;
+        return *this;
+    }
+
+    StateWriter &operator&(const std::string &text)
+    {
+        *this & static_cast<std::uint64_t>(text.size());
+        data.insert(data.end(), text.begin(), text.end());
+        return *this;
+    }
+
+    const std::vector<unsigned char> &bytes() const { return data; }
+
+private:
+    std::vector<unsigned char> data;
+};
+
+// Reads back what a StateWriter wrote, in the same order.
+class StateReader
+{
+public:
+    StateReader(const unsigned char *data, std::size_t size) : at(data), end(data + size) {}
+
+    template <class T>
+    StateReader &operator&(T &value)
+    {
+        if constexpr (std::is_arithmetic<T>::value || std::is_enum<T>::value)
+        {
+            take(&value, sizeof(T));
+        }
+        else
+        {
+            value.serialize(*this, 0u);
+        }
+        return *this;
+    }
+
+    template <class T>
+    StateReader &operator&(std::vector<T> &values)
+    {
+        std::uint64_t n = 0;
+        *this & n;
+        values.resize(static_cast<std::size_t>(n));
+        for (T &v : values) *this & v;
+        return *this;
+    }
+
+    StateReader &operator&(std::string &text)
+    {
+        std::uint64_t n = 0;
+        *this & n;
+        if (n > static_cast<std::uint64_t>(end - at)) throw std::runtime_error("truncated state");
+        text.assign(reinterpret_cast<const char *>(at), static_cast<std::size_t>(n));
+        at += n;
+        return *this;
+    }
+
+    bool done() const { return at == end; }
+
+private:
+    void take(void *out, std::size_t bytes)
+    {
+        if (bytes > static_cast<std::size_t>(end - at)) throw std::runtime_error("truncated state");
+        std::memcpy(out, at, bytes);
+        at += bytes;
+    }
+
+    const unsigned char *at;
+    const unsigned char *end;
+};
+
+template <class Stats>
+class BlockTree
+{
+public:
+    BlockTree(long long nBlocks, Stats empty) : nBlocks(nBlocks), empty(std::move(empty))
+    {
+        if (nBlocks < 1) throw std::invalid_argument("a block tree needs at least one block");
+        while ((1LL << rootLevel) < nBlocks) rootLevel++;
+    }
+
+    long long blocks() const { return nBlocks; }
+
+    // The statistics of block b.
+    void add(long long b, Stats stats) { insert(0, b, std::move(stats)); }
+
+    // All subtrees of another tree over the same blocks (and a disjoint
+    // set of them).
+    void absorb(BlockTree &&other)
+    {
+        if (other.nBlocks != nBlocks) throw std::invalid_argument("cannot absorb a tree over other blocks");
+        for (auto &node : other.nodes) insert(node.first.first, node.first.second, std::move(node.second));
+        other.nodes.clear();
+    }
+
+    bool complete() const { return nodes.size() == 1 && nodes.begin()->first.first == rootLevel; }
+
+    // The canonical merge of all blocks; throws unless every block is in.
+    const Stats &result() const
+    {
+        if (!complete()) throw std::logic_error("block tree is missing blocks");
+        return nodes.begin()->second;
+    }
+
+    // Subtrees as (level, index, stats) records; reading inserts them
+    // into an empty tree.
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int)
+    {
+        std::uint64_t n = nodes.size();
+        ar &nBlocks &n;
+        if constexpr (std::is_same<Archive, StateReader>::value)
+        {
+            std::map<std::pair<int, long long>, Stats> read;
+            for (std::uint64_t k = 0; k < n; k++)
+            {
+                int level = 0;
+                long long index = 0;
+                Stats stats = empty;
+                ar &level &index &stats;
+                read.emplace(std::make_pair(level, index), std::move(stats));
+            }
+            rootLevel = 0;
+            while ((1LL << rootLevel) < nBlocks) rootLevel++;
+            nodes.clear();
+            for (auto &node : read) insert(node.first.first, node.first.second, std::move(node.second));
+        }
+        else
+        {
+            for (auto &node : nodes)
+            {
+                int level = node.first.first;
+                long long index = node.first.second;
+                ar &level &index &node.second;
+            }
+        }
+    }
+
+private:
+    // Insert the subtree (level, index) and merge upwards while its
+    // sibling is present. A sibling that lies entirely past the last block
+    // is empty: the node moves up unchanged.
+    void insert(int level, long long index, Stats stats)
+    {
+        while (level < rootLevel)
+        {
+            long long sibling = index ^ 1;
+            if ((sibling << level) >= nBlocks)
+            {
+                level++;
+                index >>= 1;
+                continue;
+            }
+            auto it = nodes.find({level, sibling});
+            if (it == nodes.end()) break;
+            if (index & 1)
+            {
+                Stats left = std::move(it->second);
+                left.merge(stats);
+                stats = std::move(left);
+            }
+            else
+            {
+                stats.merge(it->second);
+            }
+            nodes.erase(it);
+            level++;
+            index >>= 1;
+        }
+        if (!nodes.emplace(std::make_pair(level, index), std::move(stats)).second)
+            throw std::logic_error("block " + std::to_string(index << level) + " inserted twice");
+    }
+
+    long long nBlocks;
+    Stats empty;
+    int rootLevel = 0;
+    std::map<std::pair<int, long long>, Stats> nodes;   // (level, index) -> merged blocks
+};
+
+// Runs block(b, rng, stats) for b in [first, last) on nThreads threads,
+// each block into its own copy of 'empty', and returns them as a partial
+// BlockTree over nBlocks blocks. Block b gets stream b * streamsPerBlock of
+// 'seed' (a block that splits its engine, e.g. into lanes, owns the
+// streamsPerBlock streams from there on).
+template <class Engine = Xoshiro256StarStar, class Stats, class Block>
+BlockTree<Stats> runBlockRange(const Stats &empty, long long nBlocks, long long first, long long last,
+                               std::uint64_t seed, unsigned nThreads, Block &&block, std::uint64_t streamsPerBlock = 1)
+{
+    if (nThreads == 0) nThreads = 1;
+    const long long count = last > first ? last - first : 0;
+    std::vector<Engine> all = makeStreamsOf<Engine>(seed, static_cast<std::uint64_t>(first) * streamsPerBlock,
+                                                    static_cast<std::size_t>(count * streamsPerBlock));
+    std::vector<Stats> blockStats(static_cast<std::size_t>(count), empty);
+    std::atomic<long long> next(0);
+    auto worker = [&]() {
+        for (long long k = next++; k < count; k = next++)
+            block(first + k, all[static_cast<std::size_t>(k * streamsPerBlock)], blockStats[k]);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers) w.join();
+
+    BlockTree<Stats> tree(nBlocks, empty);
+    for (long long k = 0; k < count; k++) tree.add(first + k, std::move(blockStats[k]));
+    return tree;
+}
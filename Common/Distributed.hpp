@@ -0,0 +1,140 @@
+/************************************************************
+ * Distributed replications over MPI ranks.
+ *
+ * A run is a fixed number of blocks of replications; block b
+ * always runs on stream b (times streamsPerBlock) of the global
+ * seed. Rank k of n takes the contiguous share blockRange(
+ * nBlocks, k, n), runs it on its threads (runBlockRange) and
+ * holds the result as a partial BlockTree. treeReduce then
+ * combines the partial trees along a binomial tree of ranks
+ * (rank k receives from k + 1, k + 2, k + 4, ... while those
+ * exist, then sends to its parent), which takes log2(n) rounds
+ * and only ever joins adjacent block ranges. BlockTree merges
+ * the blocks along its own canonical tree, so the aggregate has
+ * the same bits on 1 rank, on 32 ranks and for any number of
+ * threads per rank. That holds across nodes that run the same
+ * binary on the same ISA: a kernel may take a different vector
+ * path per ISA (countHits fuses x*x + y*y with AVX-512 but not
+ * with AVX2), so a mixed cluster can round a block differently.
+ *
+ * Compile with mpicxx, run with mpirun; see
+ * ParameterSweep/DistributedReplications.cpp.
+ ************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+#include "BlockReduce.hpp"
+
+// MPI_Init / MPI_Finalize for the lifetime of main.
+class MpiSession
+{
+public:
+    MpiSession(int &argc, char **&argv)
+    {
+        MPI_Init(&argc, &argv);
+        MPI_Comm_rank(MPI_COMM_WORLD, &rankValue);
+        MPI_Comm_size(MPI_COMM_WORLD, &sizeValue);
+    }
+
+    MpiSession(const MpiSession &) = delete;
+    MpiSession &operator=(const MpiSession &) = delete;
+
+    ~MpiSession() { MPI_Finalize(); }
+
+    int rank() const { return rankValue; }
+    int size() const { return sizeValue; }
+
+private:
+    int rankValue = 0;
+    int sizeValue = 1;
+};
+
+namespace distributed
+{
+constexpr int TREE_TAG = 4711;
+
+inline void sendBytes(const std::vector<unsigned char> &bytes, int to, MPI_Comm comm)
+{
+    if (bytes.size() > static_cast<std::size_t>(INT32_MAX)) throw std::runtime_error("partial result too large for MPI_Send");
+    unsigned long long size = bytes.size();
+    MPI_Send(&size, 1, MPI_UNSIGNED_LONG_LONG, to, TREE_TAG, comm);
+    MPI_Send(bytes.data(), static_cast<int>(bytes.size()), MPI_BYTE, to, TREE_TAG, comm);
+}
+
+inline std::vector<unsigned char> receiveBytes(int from, MPI_Comm comm)
+{
+    unsigned long long size = 0;
+    MPI_Recv(&size, 1, MPI_UNSIGNED_LONG_LONG, from, TREE_TAG, comm, MPI_STATUS_IGNORE);
+    if (size > static_cast<unsigned long long>(INT32_MAX)) throw std::runtime_error("partial result too large for MPI_Recv");
+    std::vector<unsigned char> bytes(static_cast<std::size_t>(size));
+    MPI_Recv(bytes.data(), static_cast<int>(size), MPI_BYTE, from, TREE_TAG, comm, MPI_STATUS_IGNORE);
+    return bytes;
+}
+} // namespace distributed
+
+// Combine the partial trees of all ranks of 'comm' into 'tree' on rank 0,
+// then broadcast the complete tree, so every rank returns the aggregate.
+template <class Stats>
+Stats treeReduce(BlockTree<Stats> tree, const Stats &empty, MPI_Comm comm = MPI_COMM_WORLD)
+{
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    for (int step = 1; step < size; step *= 2)
+    {
+        if (rank % (2 * step) != 0)
+        {
+            StateWriter out;
+            out &tree;
+            distributed::sendBytes(out.bytes(), rank - step, comm);
+            break;
+        }
+        if (rank + step < size)
+        {
+            std::vector<unsigned char> bytes = distributed::receiveBytes(rank + step, comm);
+            StateReader in(bytes.data(), bytes.size());
+            BlockTree<Stats> part(tree.blocks(), empty);
+            in &part;
+            tree.absorb(std::move(part));
+        }
+    }
+
+    // Rank 0 now holds the root; hand it to everybody.
+    std::vector<unsigned char> bytes;
+    if (rank == 0)
+    {
+        StateWriter out;
+        out &tree.result();
+        bytes = out.bytes();
+    }
+    unsigned long long n = bytes.size();
+    MPI_Bcast(&n, 1, MPI_UNSIGNED_LONG_LONG, 0, comm);
+    bytes.resize(static_cast<std::size_t>(n));
+    MPI_Bcast(bytes.data(), static_cast<int>(n), MPI_BYTE, 0, comm);
+    Stats result = empty;
+    StateReader in(bytes.data(), bytes.size());
+    in &result;
+    return result;
+}
+
+// nBlocks blocks of block(b, rng, stats) spread over the ranks of 'comm'
+// and the threads of every rank; returns the aggregate on every rank.
+template <class Engine = Xoshiro256StarStar, class Stats, class Block>
+Stats runDistributed(const Stats &empty, long long nBlocks, std::uint64_t seed, unsigned nThreads, Block &&block,
+                     std::uint64_t streamsPerBlock = 1, MPI_Comm comm = MPI_COMM_WORLD)
+{
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    std::pair<long long, long long> share = blockRange(nBlocks, rank, size);
+    BlockTree<Stats> tree = runBlockRange<Engine>(empty, nBlocks, share.first, share.second, seed, nThreads, block,
+                                                  streamsPerBlock);
+    return treeReduce(std::move(tree), empty, comm);
+}
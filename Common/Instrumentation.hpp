@@ -0,0 +1,291 @@
+/************************************************************
+ * Hot-path counters and phase timers that compile out.
+ *
+ * Build with -DSTOCHSIM_INSTRUMENT (CMake option of the same
+ * name) to enable them; otherwise the macros below expand to
+ * nothing and the kernels compile to exactly the same code.
+ *
+ *  - STOCHSIM_COUNT(Counter::X, n): add n to counter X of the
+ *    calling thread. Counters are per thread (a relaxed store
+ *    to thread-local memory, no locked instruction), so draws
+ *    can be counted in the engines themselves.
+ *  - STOCHSIM_PHASE("name"): time the rest of the enclosing
+ *    scope under 'name'. Timers read the steady clock twice,
+ *    so put them around setup steps and whole runs, not around
+ *    single draws or events. Nested phases are inclusive.
+ *  - instrumentation::writeJson(out, label): the totals over all
+ *    threads (including finished ones) since the last reset(),
+ *    as one JSON object. It also works when compiled out and
+ *    then reports "enabled": false and no counts.
+ ************************************************************/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace instrumentation
+{
+enum class Counter
+{
+    RngDraws,        // 64-bit words taken from the xoshiro and Philox engines
+    Proposals,       // candidates of an acceptance-rejection step (thinning)
+    Rejections,      // candidates rejected
+    Allocations,     // buffers allocated or grown by the kernels
+    QueuePushes,     // event / server heap insertions
+    QueuePops,       // event / server heap removals
+    QueueRebuilds,   // whole-heap passes (FES.updateEventTimes)
+    COUNT
+};
+
+constexpr int COUNTERS = static_cast<int>(Counter::COUNT);
+
+inline const char *counterName(int c)
+{
+    static const char *const names[COUNTERS] = {"rng_draws", "proposals", "rejections", "allocations",
+                                                "queue_pushes", "queue_pops", "queue_rebuilds"};
+    return names[c];
+}
+
+struct PhaseTotal
+{
+    std::string name;
+    std::uint64_t calls = 0;
+    std::uint64_t nanoseconds = 0;
+};
+
+// The counters and phases of one thread. Only the owning thread writes
+// them; writeJson reads the counters while it runs (hence the atomics) and
+// the phases under 'lock'.
+struct ThreadRecord
+{
+    std::atomic<std::uint64_t> counts[COUNTERS] = {};
+    std::mutex lock;
+    std::vector<PhaseTotal> phases;
+
+    void addPhase(const char *name, std::uint64_t ns, std::uint64_t calls = 1)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (PhaseTotal &p : phases)
+        {
+            if (p.name == name)
+            {
+                p.calls += calls;
+                p.nanoseconds += ns;
+                return;
+            }
+        }
+        phases.push_back({name, calls, ns});
+    }
+};
+
+// All live thread records, plus the totals of threads that have exited.
+struct Registry
+{
+    std::mutex lock;
+    std::vector<ThreadRecord *> live;
+    ThreadRecord retired;
+    std::size_t threadsSeen = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+inline Registry &registry()
+{
+    static Registry r;
+    return r;
+}
+
+// Folds the thread's record into the retired totals when the thread ends.
+struct ThreadRetirer
+{
+    std::unique_ptr<ThreadRecord> record;
+
+    ~ThreadRetirer()
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        for (int c = 0; c < COUNTERS; c++)
+            r.retired.counts[c].store(r.retired.counts[c].load(std::memory_order_relaxed) +
+                                          record->counts[c].load(std::memory_order_relaxed),
+                                      std::memory_order_relaxed);
+        for (const PhaseTotal &p : record->phases) r.retired.addPhase(p.name.c_str(), p.nanoseconds, p.calls);
+        for (std::size_t i = 0; i < r.live.size(); i++)
+        {
+            if (r.live[i] == record.get())
+            {
+                r.live.erase(r.live.begin() + static_cast<std::ptrdiff_t>(i));
+                break;
+            }
+        }
+    }
+};
+
+inline ThreadRecord *registerThread()
+{
+    static thread_local ThreadRetirer retirer;
+    retirer.record.reset(new ThreadRecord());
+    Registry &r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.live.push_back(retirer.record.get());
+    r.threadsSeen++;
+    return retirer.record.get();
+}
+
+// The calling thread's record; registered on first use. The pointer is
+// trivially initialised, so the fast path is a TLS load and a test.
+inline ThreadRecord &threadRecord()
+{
+    static thread_local ThreadRecord *mine = nullptr;
+    if (mine == nullptr) mine = registerThread();
+    return *mine;
+}
+
+inline void count(Counter c, std::uint64_t n = 1)
+{
+    std::atomic<std::uint64_t> &slot = threadRecord().counts[static_cast<int>(c)];
+    slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+class ScopedPhase
+{
+public:
+    explicit ScopedPhase(const char *name) : name(name), start(std::chrono::steady_clock::now()) {}
+
+    ScopedPhase(const ScopedPhase &) = delete;
+    ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+    ~ScopedPhase()
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        threadRecord().addPhase(name, static_cast<std::uint64_t>(ns.count()));
+    }
+
+private:
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Totals over all threads since the last reset.
+struct Summary
+{
+    std::uint64_t counts[COUNTERS] = {};
+    std::vector<PhaseTotal> phases;
+    std::size_t threads = 0;
+    double wallSeconds = 0.0;
+};
+
+inline void addTotals(Summary &s, ThreadRecord &t)
+{
+    for (int c = 0; c < COUNTERS; c++) s.counts[c] += t.counts[c].load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(t.lock);
+    for (const PhaseTotal &p : t.phases)
+    {
+        bool found = false;
+        for (PhaseTotal &q : s.phases)
+        {
+            if (q.name == p.name)
+            {
+                q.calls += p.calls;
+                q.nanoseconds += p.nanoseconds;
+                found = true;
+                break;
+            }
+        }
+        if (!found) s.phases.push_back(p);
+    }
+}
+
+inline Summary summary()
+{
+    Summary s;
+    Registry &r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    addTotals(s, r.retired);
+    for (ThreadRecord *t : r.live) addTotals(s, *t);
+    s.threads = r.threadsSeen;
+    s.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - r.start).count();
+    return s;
+}
+
+// Zero all counters and phases and restart the wall clock. Call it between
+// runs, while no other thread is counting.
+inline void reset()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    auto clear = [](ThreadRecord &t) {
+        for (auto &c : t.counts) c.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> inner(t.lock);
+        t.phases.clear();
+    };
+    clear(r.retired);
+    for (ThreadRecord *t : r.live) clear(*t);
+    r.threadsSeen = r.live.size();
+    r.start = std::chrono::steady_clock::now();
+}
+
+inline void writeJsonString(std::ostream &out, const std::string &text)
+{
+    out << '"';
+    for (char ch : text)
+    {
+        if (ch == '"' || ch == '\\') out << '\\' << ch;
+        else if (static_cast<unsigned char>(ch) < 0x20) out << ' ';
+        else out << ch;
+    }
+    out << '"';
+}
+
+// One JSON object with the summary of this run ("threads" counts the
+// threads that recorded anything):
+//   {"label": ..., "enabled": true, "wall_seconds": ..., "threads": ...,
+//    "counters": {"rng_draws": ..., ...}, "rejection_rate": ...,
+//    "phases": {"name": {"calls": ..., "seconds": ...}, ...}}
+inline void writeJson(std::ostream &out, const std::string &label)
+{
+#ifdef STOCHSIM_INSTRUMENT
+    const bool enabled = true;
+#else
+    const bool enabled = false;
+#endif
+    Summary s = summary();
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::setprecision(9) << "{\"label\": ";
+    writeJsonString(out, label);
+    out << ", \"enabled\": " << (enabled ? "true" : "false") << ", \"wall_seconds\": " << s.wallSeconds
+        << ", \"threads\": " << s.threads << ",\n \"counters\": {";
+    for (int c = 0; c < COUNTERS; c++) out << (c ? ", " : "") << '"' << counterName(c) << "\": " << s.counts[c];
+    const std::uint64_t proposals = s.counts[static_cast<int>(Counter::Proposals)];
+    out << "},\n \"rejection_rate\": "
+        << (proposals ? static_cast<double>(s.counts[static_cast<int>(Counter::Rejections)]) / proposals : 0.0)
+        << ",\n \"phases\": {";
+    for (std::size_t i = 0; i < s.phases.size(); i++)
+    {
+        out << (i ? ",\n   " : "\n   ");
+        writeJsonString(out, s.phases[i].name);
+        out << ": {\"calls\": " << s.phases[i].calls << ", \"seconds\": " << s.phases[i].nanoseconds * 1e-9 << "}";
+    }
+    out << (s.phases.empty() ? "}}\n" : "\n }}\n");
+    out.flags(flags);
+    out.precision(precision);
+}
+} // namespace instrumentation
+
+#ifdef STOCHSIM_INSTRUMENT
+#define STOCHSIM_CONCAT_(a, b) a##b
+#define STOCHSIM_CONCAT(a, b) STOCHSIM_CONCAT_(a, b)
+#define STOCHSIM_COUNT(counter, n) ::instrumentation::count(::instrumentation::counter, (n))
+#define STOCHSIM_PHASE(name) ::instrumentation::ScopedPhase STOCHSIM_CONCAT(stochsimPhase, __LINE__)(name)
+#else
+#define STOCHSIM_COUNT(counter, n) ((void)0)
+#define STOCHSIM_PHASE(name) ((void)0)
+#endif
@@ -0,0 +1,388 @@
+/************************************************************
+ * Online (streaming) statistics for simulation output.
+ *
+ *  - RunningStats: count, mean, variance, min and max in O(1)
+ *    memory (Welford's algorithm).
+ *  - Histogram: fixed-width bins over [lo, hi) plus underflow
+ *    and overflow counts, with approximate quantiles.
+ *  - TimeWeightedStats: time average and variance of a
+ *    piecewise-constant signal (queue length, buffer content).
+ *  - TDigest: quantiles of a stream without fixing a range in
+ *    advance, accurate in the tails, in O(compression) memory.
+ *
+ * All are mergeable: every thread (or node, or replication) fills
+ * its own accumulator and the results are combined with merge()
+ * afterwards, so nothing is shared while the simulation runs and
+ * memory does not grow with the run length. serialize() exposes
+ * the state to an archive, so accumulators can also be merged
+ * across processes (Common/Distributed.hpp).
+ ************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+class RunningStats
+{
+public:
+    void add(double x)
+    {
+        n++;
+        double delta = x - m;
+        m += delta / n;
+        m2 += delta * (x - m);
+        lo = std::min(lo, x);
+        hi = std::max(hi, x);
+    }
+
+    // Combine with the statistics of another, disjoint set of observations
+    // (Chan et al. pairwise update).
+    void merge(const RunningStats &other)
+    {
+        if (other.n == 0) return;
+        if (n == 0)
+        {
+            *this = other;
+            return;
+        }
+        double total = static_cast<double>(n) + static_cast<double>(other.n);
+        double delta = other.m - m;
+        m += delta * (static_cast<double>(other.n) / total);
+        m2 += other.m2 + delta * delta * (static_cast<double>(n) * static_cast<double>(other.n) / total);
+        n += other.n;
+        lo = std::min(lo, other.lo);
+        hi = std::max(hi, other.hi);
+    }
+
+    long long count() const { return n; }
+    double mean() const { return m; }
+    // Sample variance (divides by n - 1).
+    double variance() const { return n > 1 ? m2 / (n - 1) : 0.0; }
+    double stddev() const { return std::sqrt(variance()); }
+    double standardError() const { return n > 0 ? std::sqrt(variance() / n) : 0.0; }
+    // Half-width of the normal-approximation confidence interval mean +- z * SE.
+    double ciHalfWidth(double z = 1.96) const { return z * standardError(); }
+    double min() const { return lo; }
+    double max() const { return hi; }
+
+    // The members, for an archive (Common/BlockReduce.hpp or
+    // Boost.Serialization), to send the statistics between processes.
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int)
+    {
+        ar &n &m &m2 &lo &hi;
+    }
+
+private:
+    long long n = 0;
+    double m = 0.0;
+    double m2 = 0.0;   // sum of squared deviations from the mean
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+};
+
+class Histogram
+{
+public:
+    Histogram(double lo, double hi, int nBins)
+        : lo(lo), hi(hi), width((hi - lo) / nBins), counts(static_cast<std::size_t>(nBins), 0)
+    {
+        if (!(hi > lo) || nBins <= 0) throw std::invalid_argument("histogram needs lo < hi and at least one bin");
+    }
+
+    void add(double x)
+    {
+        if (x < lo) under++;
+        else if (x >= hi) over++;
+        else
+        {
+            std::size_t bin = static_cast<std::size_t>((x - lo) / width);
+            counts[std::min(bin, counts.size() - 1)]++;
+        }
+    }
+
+    // Add the counts of a histogram with the same layout.
+    void merge(const Histogram &other)
+    {
+        if (other.lo != lo || other.hi != hi || other.counts.size() != counts.size())
+            throw std::invalid_argument("cannot merge histograms with different bins");
+        for (std::size_t i = 0; i < counts.size(); i++) counts[i] += other.counts[i];
+        under += other.under;
+        over += other.over;
+    }
+
+    // Forget all observations, keeping the bins.
+    void clear()
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+        under = over = 0;
+    }
+
+    int bins() const { return static_cast<int>(counts.size()); }
+    double binLower(int i) const { return lo + i * width; }
+    double binWidth() const { return width; }
+    long long binCount(int i) const { return counts[static_cast<std::size_t>(i)]; }
+    long long underflow() const { return under; }
+    long long overflow() const { return over; }
+
+    long long count() const
+    {
+        long long total = under + over;
+        for (long long c : counts) total += c;
+        return total;
+    }
+
+    // Approximate q-quantile, interpolating linearly inside the bin that
+    // contains it. Quantiles that fall in the underflow / overflow region
+    // are clamped to lo / hi.
+    double quantile(double q) const
+    {
+        long long total = count();
+        if (total == 0) return std::numeric_limits<double>::quiet_NaN();
+        double target = q * static_cast<double>(total);
+        double seen = static_cast<double>(under);
+        if (target <= seen) return lo;
+        for (std::size_t i = 0; i < counts.size(); i++)
+        {
+            double c = static_cast<double>(counts[i]);
+            if (seen + c >= target && c > 0)
+                return lo + (static_cast<double>(i) + (target - seen) / c) * width;
+            seen += c;
+        }
+        return hi;
+    }
+
+    // The members, for an archive (see RunningStats).
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int)
+    {
+        ar &lo &hi &width &counts &under &over;
+    }
+
+private:
+    double lo, hi, width;
+    std::vector<long long> counts;
+    long long under = 0, over = 0;
+};
+
+// Time average of a piecewise-constant signal. observe(now, v) records that
+// the signal was v since the previous observation (or since startTime), so
+// a simulator calls it at every event with the state the system had just
+// before the event. merge() adds the time and the integrals of another,
+// disjoint observation window (a replication or a time slice), so the
+// merged mean is the average over all windows together.
+class TimeWeightedStats
+{
+public:
+    explicit TimeWeightedStats(double startTime = 0.0) : last(startTime) {}
+
+    void observe(double now, double value)
+    {
+        double dt = now - last;
+        if (dt > 0)
+        {
+            area += value * dt;
+            area2 += value * value * dt;
+            elapsed += dt;
+            last = now;
+        }
+        n++;
+    }
+
+    void merge(const TimeWeightedStats &other)
+    {
+        area += other.area;
+        area2 += other.area2;
+        elapsed += other.elapsed;
+        n += other.n;
+    }
+
+    long long count() const { return n; }
+    double duration() const { return elapsed; }
+    double lastTime() const { return last; }
+    double mean() const { return elapsed > 0 ? area / elapsed : 0.0; }
+    // Time-weighted variance of the signal (not of the mean estimate,
+    // which needs batch means or replications because of correlation).
+    double variance() const { return elapsed > 0 ? std::max(0.0, area2 / elapsed - mean() * mean()) : 0.0; }
+
+    // The members, for an archive (see RunningStats).
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int)
+    {
+        ar &last &area &area2 &elapsed &n;
+    }
+
+private:
+    double last;
+    double area = 0.0;
+    double area2 = 0.0;
+    double elapsed = 0.0;
+    long long n = 0;
+};
+
+// t-digest (Dunning's merging variant). Values are buffered and then merged,
+// in sorted order, into centroids (mean, weight). A centroid may only grow
+// while it spans at most one unit of the scale function
+// k(q) = compression / (2 pi) * asin(2q - 1), which keeps centroids small
+// near q = 0 and q = 1, so tail quantiles stay accurate; there are at most
+// about compression centroids. Digests merge by merging their centroids.
+class TDigest
+{
+public:
+    explicit TDigest(double compression = 100.0)
+        : compression(compression), bufferLimit(static_cast<std::size_t>(5 * compression))
+    {
+        if (!(compression >= 10)) throw std::invalid_argument("t-digest compression must be at least 10");
+    }
+
+    void add(double x)
+    {
+        buffer.push_back(x);
+        lo = std::min(lo, x);
+        hi = std::max(hi, x);
+        if (buffer.size() >= bufferLimit) compress();
+    }
+
+    void merge(const TDigest &other)
+    {
+        compress();
+        other.compress();
+        std::vector<Centroid> sorted(centroids.size() + other.centroids.size());
+        std::merge(centroids.begin(), centroids.end(), other.centroids.begin(), other.centroids.end(), sorted.begin(),
+                   byMean);
+        lo = std::min(lo, other.lo);
+        hi = std::max(hi, other.hi);
+        collapse(sorted);
+    }
+
+    double count() const
+    {
+        compress();
+        return total;
+    }
+
+    std::size_t centroidCount() const
+    {
+        compress();
+        return centroids.size();
+    }
+
+    double min() const { return lo; }
+    double max() const { return hi; }
+
+    // Approximate q-quantile: linear interpolation between centroid
+    // centres, and between the extreme centroids and the min / max.
+    double quantile(double q) const
+    {
+        compress();
+        if (centroids.empty()) return std::numeric_limits<double>::quiet_NaN();
+        if (q <= 0) return lo;
+        if (q >= 1) return hi;
+        const double target = q * total;
+        const Centroid &first = centroids.front(), &lastC = centroids.back();
+        if (target < first.weight / 2)
+            return lo + (first.mean - lo) * (first.weight > 1 ? target / (first.weight / 2) : 0.0);
+        double cumulative = 0.0;   // weight before centroid i
+        for (std::size_t i = 0; i + 1 < centroids.size(); i++)
+        {
+            const Centroid &a = centroids[i], &b = centroids[i + 1];
+            double centreA = cumulative + a.weight / 2, centreB = cumulative + a.weight + b.weight / 2;
+            if (target < centreB)
+                return a.mean + (b.mean - a.mean) * (target - centreA) / (centreB - centreA);
+            cumulative += a.weight;
+        }
+        double centre = total - lastC.weight / 2;
+        return lastC.weight > 1 ? lastC.mean + (hi - lastC.mean) * (target - centre) / (lastC.weight / 2) : hi;
+    }
+
+    // Pending values are merged into the centroids first.
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int)
+    {
+        compress();
+        ar &compression &bufferLimit &centroids &total &lo &hi;
+    }
+
+private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+
+        template <class Archive>
+        void serialize(Archive &ar, const unsigned int)
+        {
+            ar &mean &weight;
+        }
+    };
+
+    static constexpr double pi = 3.14159265358979323846;
+    double scale(double q) const { return compression / (2 * pi) * std::asin(2 * q - 1); }
+    double inverseScale(double k) const { return 0.5 * (1 + std::sin(std::min(k * 2 * pi / compression, pi / 2))); }
+
+    static bool byMean(const Centroid &a, const Centroid &b) { return a.mean < b.mean; }
+
+    // Merge the buffer into the centroids. Const because quantile() and
+    // count() call it; the summary of the data does not change.
+    void compress() const
+    {
+        if (buffer.empty()) return;
+        std::sort(buffer.begin(), buffer.end());
+        std::vector<Centroid> sorted;
+        sorted.reserve(buffer.size() + centroids.size());
+        std::size_t c = 0;
+        for (double x : buffer)
+        {
+            while (c < centroids.size() && centroids[c].mean < x) sorted.push_back(centroids[c++]);
+            sorted.push_back({x, 1.0});
+        }
+        sorted.insert(sorted.end(), centroids.begin() + static_cast<std::ptrdiff_t>(c), centroids.end());
+        buffer.clear();
+        collapse(sorted);
+    }
+
+    // Replace the centroids by 'sorted' (ordered by mean), joining
+    // neighbours while a centroid spans at most one unit of scale().
+    void collapse(const std::vector<Centroid> &sorted) const
+    {
+        double weight = 0.0;
+        for (const Centroid &c : sorted) weight += c.weight;
+        centroids.clear();
+        if (sorted.empty()) return;
+
+        Centroid current = sorted.front();
+        double before = 0.0;   // weight of the centroids already emitted
+        double limit = weight * inverseScale(scale(0.0) + 1.0);
+        for (std::size_t i = 1; i < sorted.size(); i++)
+        {
+            const Centroid &c = sorted[i];
+            double grown = current.weight + c.weight;
+            if (before + grown <= limit)
+            {
+                current.mean += (c.mean - current.mean) * c.weight / grown;
+                current.weight = grown;
+            }
+            else
+            {
+                centroids.push_back(current);
+                before += current.weight;
+                limit = weight * inverseScale(scale(before / weight) + 1.0);
+                current = c;
+            }
+        }
+        centroids.push_back(current);
+        total = weight;
+    }
+
+    double compression;
+    std::size_t bufferLimit;
+    mutable std::vector<Centroid> centroids;
+    mutable std::vector<double> buffer;   // values not yet in a centroid
+    mutable double total = 0.0;
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+};
@@ -0,0 +1,390 @@
+/************************************************************
+ * Independent random-number streams for parallel simulation.
+ *
+ *  - Xoshiro256StarStar: small (32 byte) 64-bit generator with
+ *    a jump() that advances the state by 2^128 draws, so every
+ *    thread can get its own non-overlapping stream.
+ *  - RandomStreams: a deterministic family of such streams
+ *    derived from one seed (stream k, or a sub-family per task via
+ *    group()). makeStream(seed, k) is shorthand for stream k.
+ *    The same (seed, k) always gives the same sequence.
+ *  - makeStreamOf<Engine>(seed, k): the same for any engine picked
+ *    by template parameter (counter-based Philox in Philox.hpp).
+ *  - threadLocalGenerator(): a per-thread, randomly seeded engine
+ *    for code that does not pass one explicitly. It replaces the
+ *    function-static engines, which were a data race under threads.
+ *  - Xoshiro256StarStarLanes<L>: L generators advanced side by
+ *    side in structure-of-arrays form, so a block fill compiles
+ *    to SIMD code (build with -O3 -march=native).
+ *
+ * With -DSTOCHSIM_INSTRUMENT every draw is counted
+ * (Common/Instrumentation.hpp); otherwise nothing is added.
+ *
+ * Header only; include it with a relative path, e.g.
+ *   #include "../Common/RandomStreams.hpp"
+ ************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "Instrumentation.hpp"
+
+// SplitMix64: used only to expand a single 64-bit seed into
+// the 256-bit xoshiro state (recommended by the xoshiro authors).
+inline std::uint64_t splitMix64(std::uint64_t &state)
+{
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** 1.0 (Blackman & Vigna). Satisfies the standard
+// UniformRandomBitGenerator requirements, so it can be used with
+// any <random> distribution just like std::mt19937_64.
+class Xoshiro256StarStar
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit Xoshiro256StarStar(std::uint64_t seed = 0)
+    {
+        std::uint64_t sm = seed;
+        for (auto &word : s) word = splitMix64(sm);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        STOCHSIM_COUNT(Counter::RngDraws, 1);
+        return step();
+    }
+
+    // Advance the state by 2^128 draws. Calling jump() k times on a
+    // freshly seeded generator gives the start of stream k.
+    void jump()
+    {
+        static constexpr std::uint64_t JUMP[] = {
+            0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+            0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+        applyJump(JUMP);
+    }
+
+    // Advance the state by 2^192 draws, i.e. 2^64 jump()s. Used to give
+    // every task its own group of 2^64 streams.
+    void longJump()
+    {
+        static constexpr std::uint64_t LONG_JUMP[] = {
+            0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+            0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+        applyJump(LONG_JUMP);
+    }
+
+private:
+    template <int L>
+    friend class Xoshiro256StarStarLanes;
+
+    static std::uint64_t rotl(std::uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    // One step of the recurrence. Not counted as a draw, so that jumps
+    // (256 steps each) do not show up in the instrumentation.
+    std::uint64_t step()
+    {
+        const std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const std::uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+
+        return result;
+    }
+
+    // Multiply the state by a precomputed jump polynomial.
+    void applyJump(const std::uint64_t (&poly)[4])
+    {
+        std::uint64_t t[4] = {0, 0, 0, 0};
+        for (std::uint64_t jumpWord : poly)
+        {
+            for (int b = 0; b < 64; b++)
+            {
+                if (jumpWord & (std::uint64_t{1} << b))
+                {
+                    for (int i = 0; i < 4; i++) t[i] ^= s[i];
+                }
+                step();
+            }
+        }
+        for (int i = 0; i < 4; i++) s[i] = t[i];
+    }
+
+    std::uint64_t s[4];
+};
+
+// Number of 64-bit lanes in one native SIMD register.
+#if defined(__AVX512F__)
+constexpr int NATIVE_U64_LANES = 8;
+#elif defined(__AVX2__)
+constexpr int NATIVE_U64_LANES = 4;
+#else
+constexpr int NATIVE_U64_LANES = 2;
+#endif
+
+// L independent xoshiro256** generators stored as structure-of-arrays.
+// Lane j starts where 'first' would be after j jumps, so the lanes are
+// non-overlapping streams. fill() writes the lanes interleaved:
+// out[i*L + j] is the i-th draw of lane j.
+//
+// With GCC/Clang the state is held in vector-extension registers, which
+// compile to AVX2 / AVX-512 (or SSE2) code depending on -march. Other
+// compilers use the equivalent per-lane loop.
+template <int L>
+class Xoshiro256StarStarLanes
+{
+public:
+    explicit Xoshiro256StarStarLanes(Xoshiro256StarStar first)
+    {
+        for (int j = 0; j < L; j++)
+        {
+            s0[j] = first.s[0];
+            s1[j] = first.s[1];
+            s2[j] = first.s[2];
+            s3[j] = first.s[3];
+            first.jump();
+        }
+    }
+
+    // n must be a multiple of L.
+    void fill(std::uint64_t *out, std::size_t n)
+    {
+        STOCHSIM_COUNT(Counter::RngDraws, n);
+#if defined(__GNUC__)
+        // The L lanes are processed as L/W native vectors of W lanes each, so
+        // the output (and hence every result built on it) does not depend on
+        // the instruction set the code was compiled for.
+        constexpr int W = (NATIVE_U64_LANES < L) ? NATIVE_U64_LANES : L;
+        constexpr int G = L / W;
+        static_assert(L % W == 0, "lane count must be a multiple of the vector width");
+        typedef std::uint64_t Vec __attribute__((vector_size(8 * W)));
+
+        Vec a0[G], a1[G], a2[G], a3[G];
+        std::memcpy(a0, s0, sizeof a0);
+        std::memcpy(a1, s1, sizeof a1);
+        std::memcpy(a2, s2, sizeof a2);
+        std::memcpy(a3, s3, sizeof a3);
+
+        for (std::size_t i = 0; i < n; i += L)
+        {
+            for (int g = 0; g < G; g++)
+            {
+                // Same recurrence as Xoshiro256StarStar::operator(), W lanes at once.
+                // x*5 and x*9 are written as shift+add: AVX2 has no 64-bit multiply.
+                const Vec x = (a1[g] << 2) + a1[g];
+                const Vec r = (x << 7) | (x >> 57);
+                const Vec result = (r << 3) + r;
+                const Vec t = a1[g] << 17;
+
+                a2[g] ^= a0[g];
+                a3[g] ^= a1[g];
+                a1[g] ^= a2[g];
+                a0[g] ^= a3[g];
+                a2[g] ^= t;
+                a3[g] = (a3[g] << 45) | (a3[g] >> 19);
+
+                std::memcpy(out + i + g * W, &result, sizeof result);
+            }
+        }
+
+        std::memcpy(s0, a0, sizeof a0);
+        std::memcpy(s1, a1, sizeof a1);
+        std::memcpy(s2, a2, sizeof a2);
+        std::memcpy(s3, a3, sizeof a3);
+#else
+        for (std::size_t i = 0; i < n; i += L)
+        {
+            for (int j = 0; j < L; j++)
+            {
+                const std::uint64_t result = Xoshiro256StarStar::rotl(s1[j] * 5, 7) * 9;
+                const std::uint64_t t = s1[j] << 17;
+
+                s2[j] ^= s0[j];
+                s3[j] ^= s1[j];
+                s1[j] ^= s2[j];
+                s0[j] ^= s3[j];
+                s2[j] ^= t;
+                s3[j] = Xoshiro256StarStar::rotl(s3[j], 45);
+
+                out[i + j] = result;
+            }
+        }
+#endif
+    }
+
+private:
+    alignas(64) std::uint64_t s0[L];
+    alignas(64) std::uint64_t s1[L];
+    alignas(64) std::uint64_t s2[L];
+    alignas(64) std::uint64_t s3[L];
+};
+
+// A deterministic family of non-overlapping streams derived from one seed.
+// Stream k starts k jumps (k * 2^128 draws) after the seeded state, so any
+// two streams of the family are disjoint. It is cheap to copy and has no
+// mutable state, so one instance can be shared by all threads:
+//
+//   RandomStreams streams(seed);
+//   // in worker thread t:
+//   Xoshiro256StarStar rng = streams.stream(t);
+//
+// Deriving stream k costs k jumps (each about 256 draws); use streams() to
+// get a run of consecutive streams in one pass. For arbitrary seeking
+// inside a stream use a counter-based engine instead.
+class RandomStreams
+{
+public:
+    explicit RandomStreams(std::uint64_t seed)
+        : seedValue(seed), base(seed)
+    {
+    }
+
+    std::uint64_t seed() const { return seedValue; }
+
+    Xoshiro256StarStar stream(std::uint64_t index) const
+    {
+        Xoshiro256StarStar rng = base;
+        for (std::uint64_t k = 0; k < index; k++) rng.jump();
+        return rng;
+    }
+
+    // Streams first .. first+count-1.
+    std::vector<Xoshiro256StarStar> streams(std::uint64_t first, std::size_t count) const
+    {
+        std::vector<Xoshiro256StarStar> result;
+        result.reserve(count);
+        Xoshiro256StarStar rng = stream(first);
+        for (std::size_t k = 0; k < count; k++)
+        {
+            result.push_back(rng);
+            rng.jump();
+        }
+        return result;
+    }
+
+    // Sub-family number g: its streams start g long jumps (g * 2^192 draws)
+    // after the seeded state. Give every task (parameter point, replication)
+    // its own group and every thread inside the task its own stream; as long
+    // as a task uses fewer than 2^64 streams no two tasks overlap.
+    RandomStreams group(std::uint64_t g) const
+    {
+        RandomStreams sub = *this;
+        for (std::uint64_t k = 0; k < g; k++) sub.base.longJump();
+        return sub;
+    }
+
+private:
+    std::uint64_t seedValue;
+    Xoshiro256StarStar base;
+};
+
+// Stream number 'streamIndex' for a given seed: seed once, then jump
+// 'streamIndex' times. Streams are 2^128 draws apart, so they never
+// overlap in practice.
+inline Xoshiro256StarStar makeStream(std::uint64_t seed, std::uint64_t streamIndex)
+{
+    return RandomStreams(seed).stream(streamIndex);
+}
+
+// Stream derivation for an engine chosen at compile time:
+//   Engine rng = makeStreamOf<Engine>(seed, k);
+// Xoshiro256StarStar uses jump-ahead (RandomStreams); Philox4x32 (see
+// Philox.hpp) uses its counter. Any other standard engine is seeded from
+// std::seed_seq{seed, k}, which gives distinct but not provably disjoint
+// streams.
+template <class Engine>
+struct StreamFactory
+{
+    static Engine make(std::uint64_t seed, std::uint64_t streamIndex)
+    {
+        std::seed_seq seq{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                          static_cast<std::uint32_t>(streamIndex), static_cast<std::uint32_t>(streamIndex >> 32)};
+        return Engine(seq);
+    }
+};
+
+template <>
+struct StreamFactory<Xoshiro256StarStar>
+{
+    static Xoshiro256StarStar make(std::uint64_t seed, std::uint64_t streamIndex)
+    {
+        return makeStream(seed, streamIndex);
+    }
+};
+
+template <class Engine>
+Engine makeStreamOf(std::uint64_t seed, std::uint64_t streamIndex)
+{
+    return StreamFactory<Engine>::make(seed, streamIndex);
+}
+
+// Streams first .. first+count-1 of 'seed' for any engine.
+template <class Engine>
+std::vector<Engine> makeStreamsOf(std::uint64_t seed, std::uint64_t first, std::size_t count)
+{
+    std::vector<Engine> result;
+    result.reserve(count);
+    for (std::size_t k = 0; k < count; k++) result.push_back(makeStreamOf<Engine>(seed, first + k));
+    return result;
+}
+
+// xoshiro: one pass of jumps instead of deriving every stream from scratch.
+template <>
+inline std::vector<Xoshiro256StarStar> makeStreamsOf<Xoshiro256StarStar>(std::uint64_t seed, std::uint64_t first,
+                                                                         std::size_t count)
+{
+    return RandomStreams(seed).streams(first, count);
+}
+
+// Engine for callers that do not pass one: every thread gets its own
+// xoshiro256**, seeded once from std::random_device. Results are not
+// reproducible; pass a stream from RandomStreams for that.
+inline Xoshiro256StarStar &threadLocalGenerator()
+{
+    thread_local Xoshiro256StarStar gen([] {
+        std::random_device rd;
+        return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+    }());
+    return gen;
+}
+
+// Map a 64-bit random word to a double in [0, 1) using the top 53 bits.
+// Unlike std::uniform_real_distribution the result is fully specified,
+// so runs are bit-identical across compilers and standard libraries.
+inline double toUnitDouble(std::uint64_t word)
+{
+    return static_cast<double>(word >> 11) * 0x1.0p-53;
+}
+
+// Same idea with 52 bits: put the top bits of the word into the mantissa of
+// a double in [1, 2) and subtract 1. This only needs integer shifts/ors, so
+// it vectorizes on targets without a 64-bit integer -> double instruction
+// (e.g. AVX2). Used by the batched kernels.
+inline double toUnitDouble52(std::uint64_t word)
+{
+    const std::uint64_t bits = (word >> 12) | 0x3ff0000000000000ULL;
+    double d;
+    std::memcpy(&d, &bits, sizeof d);
+    return d - 1.0;
+}
@@ -0,0 +1,151 @@
+/************************************************************
+ * Sequential stopping: run an estimator until its confidence
+ * interval is as narrow as requested.
+ *
+ * runUntilPrecision hands chunks of chunkSize samples to the
+ * threads; chunk k runs on stream k of the seed and returns its
+ * mean. The chunk means are the batch means: they go, in chunk
+ * order, into a Welford accumulator, and after every chunk the
+ * Student-t interval of the batch means is compared with the
+ * target. The first prefix of chunks that meets it is the
+ * result, so the estimate, its half-width and the samples used
+ * are the same for any number of threads; chunks that finished
+ * after that point are discarded (samplesDrawn counts them).
+ *
+ * Batch means also give valid intervals for correlated output
+ * (e.g. a queue's waiting times) as long as a chunk is long
+ * compared with the correlation time.
+ ************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "NormalVariates.hpp"
+#include "OnlineStats.hpp"
+#include "RandomStreams.hpp"
+
+// Quantile of Student's t distribution with dof degrees of freedom
+// (Cornish-Fisher expansion around the normal quantile; relative error
+// below 1e-4 from dof = 5 on, exact in the limit).
+inline double studentTQuantile(double p, long long dof)
+{
+    const double z = inverseNormalCdf(p);
+    const double n = static_cast<double>(dof);
+    const double z2 = z * z;
+    return z + z * (z2 + 1) / (4 * n) + z * ((5 * z2 + 16) * z2 + 3) / (96 * n * n) +
+           z * (((3 * z2 + 19) * z2 + 17) * z2 - 15) / (384 * n * n * n) +
+           z * ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) / (92160 * n * n * n * n);
+}
+
+// Stop when the half-width is at most 'absolute', or at most 'relative'
+// times |estimate| (a target of 0 is not used; with both set, either one
+// suffices), but never before minBatches chunks and never after maxSamples.
+struct PrecisionTarget
+{
+    double absolute = 0.0;
+    double relative = 0.0;
+    double confidence = 0.95;
+    long long minBatches = 20;
+    long long maxSamples = 1000000000000LL;
+};
+
+struct SequentialResult
+{
+    double estimate = 0.0;
+    double halfWidth = 0.0;
+    long long samples = 0;        // samples behind the estimate
+    long long samplesDrawn = 0;   // including chunks finished after the stop
+    long long batches = 0;
+    double wallSeconds = 0.0;
+    bool converged = false;       // false if maxSamples was reached first
+    RunningStats batchMeans;
+};
+
+// chunk(rng, n) returns the mean of n samples drawn from rng. Chunk k gets
+// stream k * streamsPerChunk of 'seed', so a chunk that splits its engine
+// into several (e.g. Xoshiro256StarStarLanes) can own streamsPerChunk
+// consecutive streams.
+template <class Engine = Xoshiro256StarStar, class Chunk>
+SequentialResult runUntilPrecision(Chunk &&chunk, long long chunkSize, const PrecisionTarget &target,
+                                   std::uint64_t seed, unsigned nThreads, std::uint64_t streamsPerChunk = 1)
+{
+    if (nThreads == 0) nThreads = 1;
+    auto start = std::chrono::steady_clock::now();
+    const double tail = 0.5 * (1.0 + target.confidence);
+
+    std::mutex lock;
+    std::vector<Engine> chunkRng;      // streams of the chunks handed out so far
+    std::vector<double> means;         // means of finished chunks, by index
+    std::vector<char> finished;
+    long long handedOut = 0, prefix = 0;
+    bool stop = false;
+    SequentialResult result;
+
+    auto halfWidthNow = [&]() {
+        const long long b = result.batchMeans.count();
+        return b > 1 ? studentTQuantile(tail, b - 1) * result.batchMeans.standardError()
+                     : std::numeric_limits<double>::infinity();
+    };
+    auto reached = [&]() {
+        if (result.batchMeans.count() < std::max<long long>(target.minBatches, 2)) return false;
+        double halfWidth = halfWidthNow();
+        return (target.absolute > 0 && halfWidth <= target.absolute) ||
+               (target.relative > 0 && halfWidth <= target.relative * std::fabs(result.batchMeans.mean()));
+    };
+
+    auto worker = [&]() {
+        for (;;)
+        {
+            long long k;
+            std::optional<Engine> rng;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (stop || handedOut * chunkSize >= target.maxSamples) return;
+                if (handedOut == static_cast<long long>(chunkRng.size()))
+                {
+                    // Derive the next streams in one pass, doubling each time.
+                    std::size_t more = std::max<std::size_t>(64, chunkRng.size());
+                    std::vector<Engine> all = makeStreamsOf<Engine>(seed, chunkRng.size() * streamsPerChunk,
+                                                                    more * streamsPerChunk);
+                    for (std::size_t i = 0; i < more; i++) chunkRng.push_back(all[i * streamsPerChunk]);
+                    means.resize(chunkRng.size());
+                    finished.resize(chunkRng.size(), 0);
+                }
+                k = handedOut++;
+                rng = chunkRng[k];
+            }
+            double mean = chunk(*rng, chunkSize);
+
+            std::lock_guard<std::mutex> guard(lock);
+            result.samplesDrawn += chunkSize;
+            means[k] = mean;
+            finished[k] = 1;
+            while (!stop && prefix < handedOut && finished[prefix])
+            {
+                result.batchMeans.add(means[prefix++]);
+                result.converged = reached();
+                if (result.converged || prefix * chunkSize >= target.maxSamples) stop = true;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers) w.join();
+
+    result.estimate = result.batchMeans.mean();
+    result.halfWidth = halfWidthNow();
+    result.batches = result.batchMeans.count();
+    result.samples = result.batches * chunkSize;
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,257 @@
+/************************************************************
+ * Sobol low-discrepancy points, optionally scrambled.
+ *
+ * SobolSequence(d) gives the points of the d-dimensional Sobol
+ * sequence in Gray-code order (32-bit resolution, up to 2^32
+ * points). SobolSequence(d, rng) randomizes it with a random
+ * linear matrix scramble and a digital shift (Matousek) drawn
+ * from rng: every engine gives an independent, uniformly
+ * distributed copy of the same net, so R streams give R i.i.d.
+ * estimates and hence a randomized-QMC error estimate.
+ * skipTo(n) jumps to point n, so a sequence can be split into
+ * blocks that threads generate independently.
+ *
+ * Direction numbers: dimensions 1..21 use the Joe-Kuo
+ * (new-joe-kuo-6.21201) table; further dimensions take the next
+ * primitive polynomials, in the same order, with pseudo-random
+ * odd initial direction numbers. Those are valid Sobol
+ * dimensions but less tuned, so put the important coordinates
+ * first (e.g. with a Brownian bridge).
+ *
+ * PseudoRandomPoints has the same next(point) interface on top
+ * of an ordinary engine, so estimators can be written once for
+ * both kinds of point source.
+ ************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "RandomStreams.hpp"
+
+namespace sobolDetail
+{
+// Product of a and b modulo p in GF(2)[x], polynomials as bit masks.
+inline std::uint64_t mulMod(std::uint64_t a, std::uint64_t b, std::uint64_t p, int degree)
+{
+    std::uint64_t r = 0;
+    while (b)
+    {
+        if (b & 1) r ^= a;
+        b >>= 1;
+        a <<= 1;
+        if (a >> degree & 1) a ^= p;
+    }
+    return r;
+}
+
+inline std::uint64_t powMod(std::uint64_t e, std::uint64_t p, int degree)
+{
+    std::uint64_t result = 1, base = 2;   // the polynomial x
+    while (e)
+    {
+        if (e & 1) result = mulMod(result, base, p, degree);
+        base = mulMod(base, base, p, degree);
+        e >>= 1;
+    }
+    return result;
+}
+
+// A polynomial of degree s is primitive iff x has order exactly 2^s - 1.
+inline bool isPrimitive(std::uint64_t p, int degree)
+{
+    const std::uint64_t order = (std::uint64_t{1} << degree) - 1;
+    if (powMod(order, p, degree) != 1) return false;
+    std::uint64_t n = order;
+    for (std::uint64_t q = 2; q * q <= n; q++)
+    {
+        if (n % q != 0) continue;
+        if (powMod(order / q, p, degree) == 1) return false;
+        while (n % q == 0) n /= q;
+    }
+    return n == 1 || n == order || powMod(order / n, p, degree) != 1;
+}
+
+struct Polynomial
+{
+    int degree;
+    std::uint32_t a;                 // middle coefficients, as in the Joe-Kuo files
+    std::vector<std::uint32_t> m;    // initial direction numbers m_1..m_degree
+};
+
+// Joe-Kuo initial direction numbers for dimensions 2..21.
+inline const std::vector<std::vector<std::uint32_t>> &joeKuoM()
+{
+    static const std::vector<std::vector<std::uint32_t>> m = {
+        {1},
+        {1, 3},
+        {1, 3, 1},
+        {1, 1, 1},
+        {1, 1, 3, 3},
+        {1, 3, 5, 13},
+        {1, 1, 5, 5, 17},
+        {1, 1, 5, 5, 5},
+        {1, 1, 7, 11, 19},
+        {1, 1, 5, 1, 1},
+        {1, 1, 1, 3, 11},
+        {1, 3, 5, 5, 31},
+        {1, 3, 3, 9, 7, 49},
+        {1, 1, 1, 15, 21, 21},
+        {1, 3, 1, 13, 27, 49},
+        {1, 1, 1, 15, 7, 5},
+        {1, 3, 1, 15, 13, 25},
+        {1, 1, 5, 5, 19, 61},
+        {1, 3, 7, 11, 23, 15, 103},
+        {1, 3, 7, 13, 13, 15, 69},
+    };
+    return m;
+}
+
+// Polynomials for dimensions 2..dimension: all primitive polynomials in
+// order of degree and then of a.
+inline std::vector<Polynomial> polynomials(int dimension)
+{
+    std::vector<Polynomial> polys;
+    std::uint64_t state = 0x5eed5eed5eedULL;   // fixed, so every run gets the same table
+    for (int degree = 1; static_cast<int>(polys.size()) < dimension - 1; degree++)
+    {
+        if (degree > 31) throw std::invalid_argument("Sobol dimension too large");
+        for (std::uint32_t a = 0; a < (1u << (degree - 1)) && static_cast<int>(polys.size()) < dimension - 1; a++)
+        {
+            std::uint64_t p = (std::uint64_t{1} << degree) | (static_cast<std::uint64_t>(a) << 1) | 1;
+            if (!isPrimitive(p, degree)) continue;
+            Polynomial poly{degree, a, {}};
+            std::size_t index = polys.size();
+            if (index < joeKuoM().size())
+            {
+                poly.m = joeKuoM()[index];
+            }
+            else
+            {
+                for (int k = 1; k <= degree; k++)
+                    poly.m.push_back(static_cast<std::uint32_t>(splitMix64(state) % (1u << k)) | 1u);
+            }
+            polys.push_back(poly);
+        }
+    }
+    return polys;
+}
+
+// Direction numbers v[j * 32 + i] (bit 31 is the most significant digit).
+inline std::vector<std::uint32_t> directions(int dimension)
+{
+    std::vector<std::uint32_t> v(static_cast<std::size_t>(dimension) * 32);
+    for (int i = 0; i < 32; i++) v[i] = 1u << (31 - i);
+    std::vector<Polynomial> polys = polynomials(dimension);
+    for (int j = 1; j < dimension; j++)
+    {
+        const Polynomial &poly = polys[j - 1];
+        const int s = poly.degree;
+        std::uint32_t *dir = v.data() + static_cast<std::size_t>(j) * 32;
+        for (int i = 0; i < s && i < 32; i++) dir[i] = poly.m[i] << (31 - i);
+        for (int i = s; i < 32; i++)
+        {
+            dir[i] = dir[i - s] ^ (dir[i - s] >> s);
+            for (int k = 1; k < s; k++)
+                dir[i] ^= ((poly.a >> (s - 1 - k)) & 1) * dir[i - k];
+        }
+    }
+    return v;
+}
+} // namespace sobolDetail
+
+class SobolSequence
+{
+public:
+    // The plain Sobol sequence.
+    explicit SobolSequence(int dimension) : dim(dimension), v(sobolDetail::directions(dimension)), x(dimension, 0), shift(dimension, 0)
+    {
+        if (dimension < 1) throw std::invalid_argument("Sobol dimension must be positive");
+    }
+
+    // Randomized copy: every dimension gets a random lower-triangular
+    // binary matrix (unit diagonal) applied to its direction numbers and a
+    // random digital shift.
+    SobolSequence(int dimension, Xoshiro256StarStar rng) : SobolSequence(dimension)
+    {
+        for (int j = 0; j < dim; j++)
+        {
+            std::uint32_t row[32];
+            for (int r = 0; r < 32; r++)
+            {
+                // Output digit r depends on input digit r and the digits above it.
+                std::uint64_t above = ~((std::uint64_t{1} << (32 - r)) - 1) & 0xffffffffULL;
+                row[r] = static_cast<std::uint32_t>((std::uint64_t{1} << (31 - r)) | (rng() & above));
+            }
+            std::uint32_t *dir = v.data() + static_cast<std::size_t>(j) * 32;
+            for (int i = 0; i < 32; i++)
+            {
+                std::uint32_t scrambled = 0;
+                for (int r = 0; r < 32; r++)
+                    scrambled |= static_cast<std::uint32_t>(__builtin_parity(row[r] & dir[i])) << (31 - r);
+                dir[i] = scrambled;
+            }
+            shift[j] = x[j] = static_cast<std::uint32_t>(rng() >> 32);   // digital shift
+        }
+    }
+
+    int dimension() const { return dim; }
+
+    // Number of points handed out so far.
+    std::uint64_t index() const { return n; }
+
+    // Continue at point n: its digits are the XOR of the direction numbers
+    // picked by the bits of the Gray code of n.
+    void skipTo(std::uint64_t index)
+    {
+        if (index >> 32) throw std::out_of_range("Sobol sequence has 2^32 points");
+        const std::uint64_t gray = index ^ (index >> 1);
+        for (int j = 0; j < dim; j++)
+        {
+            std::uint32_t digits = shift[j];
+            for (int c = 0; c < 32; c++)
+                if (gray >> c & 1) digits ^= v[static_cast<std::size_t>(j) * 32 + c];
+            x[j] = digits;
+        }
+        n = index;
+    }
+
+    // Next point, in [0, 1)^dimension; coordinates are never exactly 0.
+    void next(double *point)
+    {
+        if (n >> 32) throw std::out_of_range("Sobol sequence exhausted (2^32 points)");
+        for (int j = 0; j < dim; j++) point[j] = (static_cast<double>(x[j]) + 0.5) * 0x1.0p-32;
+        n++;
+        const int c = __builtin_ctzll(n);   // Gray code: flip digit c
+        if (c < 32)
+            for (int j = 0; j < dim; j++) x[j] ^= v[static_cast<std::size_t>(j) * 32 + c];
+    }
+
+private:
+    int dim;
+    std::vector<std::uint32_t> v;       // direction numbers, 32 per dimension
+    std::vector<std::uint32_t> x;       // current point as 32-bit digits
+    std::vector<std::uint32_t> shift;   // digital shift (point 0)
+    std::uint64_t n = 0;
+};
+
+// i.i.d. uniform points from an engine, with SobolSequence's interface.
+template <class Engine = Xoshiro256StarStar>
+class PseudoRandomPoints
+{
+public:
+    PseudoRandomPoints(int dimension, Engine engine) : dim(dimension), rng(engine) {}
+
+    int dimension() const { return dim; }
+
+    void next(double *point)
+    {
+        for (int j = 0; j < dim; j++) point[j] = toUnitDouble(rng());
+    }
+
+private:
+    int dim;
+    Engine rng;
+};
@@ -0,0 +1,560 @@
+/************************************************************
+ * Columnar binary trace files for simulated paths and event
+ * streams.
+ *
+ * Layout (little-endian, every section 8-byte aligned):
+ *   header      magic "SSTRACE1", version, nColumns, seed,
+ *               nRows, nChunks, dataOffset, paramsBytes
+ *   columns     nColumns x {name[32], dtype, encoding}
+ *   params      free text, "key=value" per line
+ *   chunks      {nRows, payloadBytes} followed by the values of
+ *               every column for those rows, column after column
+ *
+ * Rows are appended through TraceWriter, which buffers chunkRows
+ * rows and writes them as one chunk; the header is rewritten after
+ * every chunk, so a file always describes only complete chunks.
+ * TraceReader maps the file and hands out pointers straight into
+ * the mapping (no copy, no parsing). Columns can be stored as
+ * 32-bit floats / ints or delta-encoded (each value minus the
+ * previous one), which for paths with small increments is what
+ * makes 8-bit or 32-bit storage possible.
+ *
+ * Common/tracefile.py reads the same files into numpy arrays.
+ ************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum class TraceType : std::uint8_t
+{
+    Float64 = 0,
+    Float32 = 1,
+    Int64 = 2,
+    Int32 = 3,
+    Int8 = 4
+};
+
+enum class TraceEncoding : std::uint8_t
+{
+    Plain = 0,   // the values themselves
+    Delta = 1    // value[i] - value[i-1], with value[-1] = 0
+};
+
+struct TraceColumn
+{
+    std::string name;
+    TraceType type;
+    TraceEncoding encoding = TraceEncoding::Plain;
+};
+
+inline std::size_t traceTypeSize(TraceType type)
+{
+    switch (type)
+    {
+    case TraceType::Float64: return 8;
+    case TraceType::Float32: return 4;
+    case TraceType::Int64: return 8;
+    case TraceType::Int32: return 4;
+    case TraceType::Int8: return 1;
+    }
+    throw std::invalid_argument("unknown trace column type");
+}
+
+inline bool traceTypeIsFloat(TraceType type)
+{
+    return type == TraceType::Float64 || type == TraceType::Float32;
+}
+
+// The TraceType stored as C++ type T.
+template <class T>
+constexpr TraceType traceTypeOf()
+{
+    static_assert(std::is_same<T, double>::value || std::is_same<T, float>::value ||
+                      std::is_same<T, std::int64_t>::value || std::is_same<T, std::int32_t>::value ||
+                      std::is_same<T, std::int8_t>::value,
+                  "trace columns hold double, float, int64, int32 or int8");
+    return std::is_same<T, double>::value         ? TraceType::Float64
+           : std::is_same<T, float>::value        ? TraceType::Float32
+           : std::is_same<T, std::int64_t>::value ? TraceType::Int64
+           : std::is_same<T, std::int32_t>::value ? TraceType::Int32
+                                                  : TraceType::Int8;
+}
+
+// "key=value" lines for the params section, numbers at full precision.
+inline std::string formatTraceParams(std::initializer_list<std::pair<const char *, double>> params)
+{
+    std::ostringstream out;
+    out.precision(17);
+    for (const auto &p : params) out << p.first << "=" << p.second << "\n";
+    return out.str();
+}
+
+namespace traceformat
+{
+constexpr char MAGIC[8] = {'S', 'S', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr std::uint32_t VERSION = 1;
+constexpr std::size_t NAME_BYTES = 32;
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t nColumns;
+    std::uint64_t seed;
+    std::uint64_t nRows;
+    std::uint64_t nChunks;
+    std::uint64_t dataOffset;
+    std::uint32_t paramsBytes;
+    std::uint32_t reserved;
+};
+static_assert(sizeof(Header) == 56, "trace header must be packed");
+
+struct ColumnRecord
+{
+    char name[NAME_BYTES];
+    std::uint8_t type;
+    std::uint8_t encoding;
+    std::uint8_t reserved[6];
+};
+static_assert(sizeof(ColumnRecord) == 40, "trace column record must be packed");
+
+struct ChunkHeader
+{
+    std::uint64_t nRows;
+    std::uint64_t payloadBytes;
+};
+
+inline std::size_t padTo(std::size_t bytes, std::size_t alignment)
+{
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+} // namespace traceformat
+
+class TraceWriter
+{
+public:
+    TraceWriter(const std::string &path, std::uint64_t seed, std::vector<TraceColumn> columns,
+                const std::string &params = "", std::size_t chunkRows = 65536)
+        : cols(std::move(columns)), staged(cols.size()), previous(cols.size()), pending(cols.size()),
+          rowOffset(cols.size() + 1, 0), chunkRows(chunkRows)
+    {
+        if (cols.empty()) throw std::invalid_argument("a trace needs at least one column");
+        if (chunkRows == 0) throw std::invalid_argument("chunkRows must be positive");
+        for (const TraceColumn &c : cols)
+        {
+            if (c.name.size() >= traceformat::NAME_BYTES) throw std::invalid_argument("trace column name too long: " + c.name);
+            traceTypeSize(c.type);   // rejects unknown types
+        }
+        for (std::size_t c = 0; c < cols.size(); c++) rowOffset[c + 1] = rowOffset[c] + traceTypeSize(cols[c].type);
+        row.resize(rowOffset.back());
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) throw std::runtime_error("cannot create trace file " + path);
+
+        std::memcpy(header.magic, traceformat::MAGIC, sizeof header.magic);
+        header.version = traceformat::VERSION;
+        header.nColumns = static_cast<std::uint32_t>(cols.size());
+        header.seed = seed;
+        header.nRows = 0;
+        header.nChunks = 0;
+        header.paramsBytes = static_cast<std::uint32_t>(params.size());
+        header.reserved = 0;
+        header.dataOffset = traceformat::padTo(
+            sizeof header + cols.size() * sizeof(traceformat::ColumnRecord) + params.size(), 64);
+
+        std::vector<unsigned char> prologue(header.dataOffset, 0);
+        unsigned char *at = prologue.data() + sizeof header;
+        for (const TraceColumn &c : cols)
+        {
+            traceformat::ColumnRecord record{};
+            std::memcpy(record.name, c.name.data(), c.name.size());
+            record.type = static_cast<std::uint8_t>(c.type);
+            record.encoding = static_cast<std::uint8_t>(c.encoding);
+            std::memcpy(at, &record, sizeof record);
+            at += sizeof record;
+        }
+        std::memcpy(at, params.data(), params.size());
+        std::memcpy(prologue.data(), &header, sizeof header);
+        if (std::fwrite(prologue.data(), 1, prologue.size(), file) != prologue.size())
+        {
+            std::fclose(file);
+            throw std::runtime_error("error writing trace file " + path);
+        }
+
+        for (std::size_t c = 0; c < cols.size(); c++) staged[c].reserve(chunkRows * traceTypeSize(cols[c].type));
+    }
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    ~TraceWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    // One value per column, in column order. Integer values go to integer
+    // columns exactly; a value that does not fit the column type throws,
+    // and then none of the row is written.
+    template <class... Values>
+    void appendRow(Values... values)
+    {
+        if (sizeof...(Values) != cols.size()) throw std::invalid_argument("appendRow needs one value per column");
+        std::size_t c = 0;
+        (encode(c++, values), ...);
+        commitRow();
+    }
+
+    // One row from an array with one value per column, for traces whose
+    // columns are only known at run time. Conversions as in appendRow.
+    void appendRowValues(const double *values)
+    {
+        for (std::size_t c = 0; c < cols.size(); c++) encode(c, values[c]);
+        commitRow();
+    }
+
+    // n rows of a single-column trace.
+    template <class T>
+    void appendValues(const T *values, std::size_t n)
+    {
+        if (cols.size() != 1) throw std::invalid_argument("appendValues is for single-column traces");
+        for (std::size_t i = 0; i < n; i++)
+        {
+            encode(0, values[i]);
+            commitRow();
+        }
+    }
+
+    // Write the rows buffered so far as a chunk.
+    void flush()
+    {
+        if (rowsStaged == 0) return;
+        std::size_t payload = 0;
+        for (const auto &bytes : staged) payload += traceformat::padTo(bytes.size(), 8);
+        traceformat::ChunkHeader chunk{rowsStaged, payload};
+        write(&chunk, sizeof chunk);
+        static const unsigned char zeros[8] = {0};
+        for (auto &bytes : staged)
+        {
+            write(bytes.data(), bytes.size());
+            write(zeros, traceformat::padTo(bytes.size(), 8) - bytes.size());
+            bytes.clear();
+        }
+        header.nRows += rowsStaged;
+        header.nChunks++;
+        rowsStaged = 0;
+
+        // Publish the new chunk in the header, then return to the end.
+        if (std::fseek(file, 0, SEEK_SET) != 0) throw std::runtime_error("cannot update trace header");
+        write(&header, sizeof header);
+        if (std::fseek(file, 0, SEEK_END) != 0) throw std::runtime_error("cannot update trace header");
+        std::fflush(file);
+    }
+
+    void close()
+    {
+        if (!file) return;
+        flush();
+        std::FILE *f = file;
+        file = nullptr;
+        if (std::fclose(f) != 0) throw std::runtime_error("error closing trace file");
+    }
+
+    std::uint64_t rows() const { return header.nRows + rowsStaged; }
+
+private:
+    void write(const void *data, std::size_t bytes)
+    {
+        if (bytes > 0 && std::fwrite(data, 1, bytes, file) != bytes) throw std::runtime_error("error writing trace file");
+    }
+
+    // Encode the value of column c into 'row' and its new running value
+    // into 'pending'. Nothing is staged until commitRow, so a value that
+    // throws leaves the trace as it was. Float deltas are taken against
+    // the value the reader reconstructs (the sum of the stored floats, in
+    // double), so rounding errors do not add up along the column.
+    template <class T>
+    void encode(std::size_t c, T value)
+    {
+        static_assert(std::is_arithmetic<T>::value, "trace values must be numbers");
+        const TraceColumn &col = cols[c];
+        const bool delta = col.encoding == TraceEncoding::Delta;
+        if (traceTypeIsFloat(col.type))
+        {
+            double x = static_cast<double>(value);
+            double stored = delta ? x - previous[c].real : x;
+            if (col.type == TraceType::Float64)
+            {
+                store(c, stored);
+            }
+            else
+            {
+                float narrowed = static_cast<float>(stored);
+                stored = narrowed;
+                store(c, narrowed);
+            }
+            if (delta) pending[c].real = previous[c].real + stored;
+        }
+        else
+        {
+            long long x = static_cast<long long>(value);
+            long long stored = delta ? x - previous[c].integer : x;
+            if (col.type == TraceType::Int64) store(c, static_cast<std::int64_t>(stored));
+            else if (col.type == TraceType::Int32) store(c, narrow<std::int32_t>(stored, col));
+            else store(c, narrow<std::int8_t>(stored, col));
+            if (delta) pending[c].integer = x;
+        }
+    }
+
+    // Stage the row encoded by encode() and flush a full chunk.
+    void commitRow()
+    {
+        for (std::size_t c = 0; c < cols.size(); c++)
+            staged[c].insert(staged[c].end(), row.begin() + rowOffset[c], row.begin() + rowOffset[c + 1]);
+        previous = pending;
+        if (++rowsStaged == chunkRows) flush();
+    }
+
+    template <class Small>
+    static Small narrow(long long x, const TraceColumn &col)
+    {
+        if (x < std::numeric_limits<Small>::min() || x > std::numeric_limits<Small>::max())
+            throw std::out_of_range("value does not fit trace column " + col.name);
+        return static_cast<Small>(x);
+    }
+
+    template <class T>
+    void store(std::size_t c, T x)
+    {
+        std::memcpy(row.data() + rowOffset[c], &x, sizeof(T));
+    }
+
+    union Previous
+    {
+        double real;
+        long long integer;
+    };
+
+    std::vector<TraceColumn> cols;
+    std::vector<std::vector<unsigned char>> staged;   // encoded values of the current chunk
+    std::vector<Previous> previous;                   // last value per column, for Delta
+    std::vector<Previous> pending;                    // 'previous' after the row being encoded
+    std::vector<unsigned char> row;                   // the row being encoded
+    std::vector<std::size_t> rowOffset;               // start of each column in 'row'
+    std::size_t chunkRows;
+    std::uint64_t rowsStaged = 0;
+    traceformat::Header header{};
+    std::FILE *file = nullptr;
+};
+
+class TraceReader
+{
+public:
+    explicit TraceReader(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open trace file " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(traceformat::Header)))
+        {
+            ::close(fd);
+            throw std::runtime_error("not a trace file: " + path);
+        }
+        mappedBytes = static_cast<std::size_t>(st.st_size);
+        void *p = ::mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("cannot map trace file " + path);
+        base = static_cast<const unsigned char *>(p);
+
+        try
+        {
+            parse(path);
+        }
+        catch (...)
+        {
+            ::munmap(const_cast<unsigned char *>(base), mappedBytes);
+            throw;
+        }
+    }
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    TraceReader(TraceReader &&other) noexcept
+        : base(other.base), mappedBytes(other.mappedBytes), header(other.header), cols(std::move(other.cols)),
+          paramText(std::move(other.paramText)), chunkOffset(std::move(other.chunkOffset)),
+          chunkRowCount(std::move(other.chunkRowCount))
+    {
+        other.base = nullptr;
+    }
+
+    ~TraceReader()
+    {
+        if (base) ::munmap(const_cast<unsigned char *>(base), mappedBytes);
+    }
+
+    std::uint64_t seed() const { return header.seed; }
+    std::uint64_t rows() const { return header.nRows; }
+    std::size_t chunks() const { return chunkOffset.size(); }
+    std::uint64_t chunkRows(std::size_t chunk) const { return chunkRowCount[chunk]; }
+    const std::vector<TraceColumn> &columns() const { return cols; }
+    const std::string &params() const { return paramText; }
+
+    std::size_t columnIndex(const std::string &name) const
+    {
+        for (std::size_t c = 0; c < cols.size(); c++)
+            if (cols[c].name == name) return c;
+        throw std::out_of_range("no trace column " + name);
+    }
+
+    // Value of "key=value" in the params section.
+    double param(const std::string &key) const
+    {
+        std::istringstream in(paramText);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::size_t eq = line.find('=');
+            if (eq != std::string::npos && line.compare(0, eq, key) == 0 && eq == key.size())
+                return std::stod(line.substr(eq + 1));
+        }
+        throw std::out_of_range("no trace parameter " + key);
+    }
+
+    // The stored values of one column in one chunk, straight from the
+    // mapping (still delta-encoded for Delta columns). T must match the
+    // column type.
+    template <class T>
+    const T *chunkData(std::size_t chunk, std::size_t column) const
+    {
+        if (traceTypeOf<T>() != cols[column].type) throw std::invalid_argument("wrong type for trace column " + cols[column].name);
+        std::size_t offset = chunkOffset[chunk] + sizeof(traceformat::ChunkHeader);
+        for (std::size_t c = 0; c < column; c++)
+            offset += traceformat::padTo(chunkRowCount[chunk] * traceTypeSize(cols[c].type), 8);
+        return reinterpret_cast<const T *>(base + offset);
+    }
+
+    // The whole column decoded into T: delta columns are summed up again,
+    // in double for float columns and in int64 for integer columns.
+    template <class T = double>
+    std::vector<T> readColumn(std::size_t column) const
+    {
+        std::vector<T> out;
+        out.reserve(static_cast<std::size_t>(header.nRows));
+        switch (cols[column].type)
+        {
+        case TraceType::Float64: decode<double>(column, out); break;
+        case TraceType::Float32: decode<float>(column, out); break;
+        case TraceType::Int64: decode<std::int64_t>(column, out); break;
+        case TraceType::Int32: decode<std::int32_t>(column, out); break;
+        case TraceType::Int8: decode<std::int8_t>(column, out); break;
+        }
+        return out;
+    }
+
+private:
+    // Append the decoded values of a column stored as S to 'out'.
+    template <class S, class T>
+    void decode(std::size_t column, std::vector<T> &out) const
+    {
+        using Sum = typename std::conditional<std::is_floating_point<S>::value, double, long long>::type;
+        const bool delta = cols[column].encoding == TraceEncoding::Delta;
+        Sum sum = 0;
+        for (std::size_t k = 0; k < chunks(); k++)
+        {
+            const S *stored = chunkData<S>(k, column);
+            for (std::uint64_t i = 0; i < chunkRowCount[k]; i++)
+            {
+                sum = delta ? sum + static_cast<Sum>(stored[i]) : static_cast<Sum>(stored[i]);
+                out.push_back(static_cast<T>(sum));
+            }
+        }
+    }
+
+    // Every size read from the file is checked against the mapping before
+    // it is used, in arithmetic that cannot wrap around.
+    void parse(const std::string &path)
+    {
+        std::memcpy(&header, base, sizeof header);
+        if (std::memcmp(header.magic, traceformat::MAGIC, sizeof header.magic) != 0)
+            throw std::runtime_error("not a trace file: " + path);
+        if (header.version != traceformat::VERSION) throw std::runtime_error("unsupported trace version in " + path);
+        if (header.dataOffset > mappedBytes) throw std::runtime_error("truncated trace file " + path);
+
+        // Column records and params text lie between the header and the data.
+        // nColumns and paramsBytes are 32-bit, so the sum fits in 64 bits.
+        const std::uint64_t metaBytes = sizeof header +
+                                        static_cast<std::uint64_t>(header.nColumns) * sizeof(traceformat::ColumnRecord) +
+                                        header.paramsBytes;
+        if (metaBytes > header.dataOffset) throw std::runtime_error("corrupt trace header in " + path);
+
+        const unsigned char *at = base + sizeof header;
+        for (std::uint32_t c = 0; c < header.nColumns; c++)
+        {
+            traceformat::ColumnRecord record;
+            std::memcpy(&record, at, sizeof record);
+            at += sizeof record;
+            if (record.type > static_cast<std::uint8_t>(TraceType::Int8))
+                throw std::runtime_error("unknown type " + std::to_string(record.type) + " of column " +
+                                         std::to_string(c) + " in " + path);
+            if (record.encoding > static_cast<std::uint8_t>(TraceEncoding::Delta))
+                throw std::runtime_error("unknown encoding " + std::to_string(record.encoding) + " of column " +
+                                         std::to_string(c) + " in " + path);
+            std::size_t len = strnlen(record.name, traceformat::NAME_BYTES);
+            cols.push_back({std::string(record.name, len), static_cast<TraceType>(record.type),
+                            static_cast<TraceEncoding>(record.encoding)});
+        }
+        paramText.assign(reinterpret_cast<const char *>(at), header.paramsBytes);
+
+        std::size_t offset = static_cast<std::size_t>(header.dataOffset);
+        std::uint64_t total = 0;
+        for (std::uint64_t k = 0; k < header.nChunks; k++)
+        {
+            traceformat::ChunkHeader chunk;
+            if (mappedBytes - offset < sizeof chunk) throw std::runtime_error("truncated trace file " + path);
+            std::memcpy(&chunk, base + offset, sizeof chunk);
+            const std::size_t left = mappedBytes - offset - sizeof chunk;
+            if (chunk.payloadBytes > left) throw std::runtime_error("truncated trace file " + path);
+            // The columns of the chunk must fit in its payload.
+            std::uint64_t needed = 0;
+            for (const TraceColumn &col : cols)
+            {
+                if (chunk.nRows > chunk.payloadBytes) throw std::runtime_error("corrupt trace chunk in " + path);
+                needed += traceformat::padTo(static_cast<std::size_t>(chunk.nRows) * traceTypeSize(col.type), 8);
+                if (needed > chunk.payloadBytes) throw std::runtime_error("corrupt trace chunk in " + path);
+            }
+            chunkOffset.push_back(offset);
+            chunkRowCount.push_back(chunk.nRows);
+            total += chunk.nRows;
+            offset += sizeof chunk + static_cast<std::size_t>(chunk.payloadBytes);
+        }
+        if (total != header.nRows) throw std::runtime_error("inconsistent trace file " + path);
+    }
+
+    const unsigned char *base = nullptr;
+    std::size_t mappedBytes = 0;
+    traceformat::Header header{};
+    std::vector<TraceColumn> cols;
+    std::string paramText;
+    std::vector<std::size_t> chunkOffset;      // file offset of every chunk header
+    std::vector<std::uint64_t> chunkRowCount;
+};
@@ -0,0 +1,358 @@
+/************************************************************
+ * Variance reduction for Monte Carlo estimators.
+ *
+ * Every estimator keeps mergeable statistics with the accessors
+ * of RunningStats (count, mean, standardError, ciHalfWidth), so
+ * blocks run on separate streams combine in a fixed order with
+ * runInBlocks, whatever the thread count.
+ *
+ *  - crudeEstimate: plain average of sample(rng)
+ *  - antitheticEstimate: every sample run twice, the second time
+ *    on the complemented engine words (AntitheticEngine), i.e.
+ *    on 1 - u for samplers that work by inversion
+ *  - ControlVariateStats: y corrected by a control c with known
+ *    mean; the coefficient Cov(y, c) / Var(c) is estimated online
+ *    from running co-moments
+ *  - StratifiedStats / stratifiedEstimate: strata of known
+ *    probability, proportional allocation
+ *  - importanceEstimate: draws from a proposal, weighted by the
+ *    likelihood ratio
+ *
+ * EstimatorComparison measures the CPU time of each estimator and
+ * reports its variance per sample and its speedup over the first
+ * (crude) one: var_crude * t_crude / (var * t), the ratio of the
+ * CPU times needed to reach the same standard error.
+ ************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "OnlineStats.hpp"
+#include "RandomStreams.hpp"
+
+// Engine adaptor for antithetic pairs. After first() the words of the base
+// engine are passed through and recorded; after second() the recorded
+// words are replayed complemented (max - w), and fresh base words follow
+// if the second run needs more of them than the first.
+template <class Engine>
+class AntitheticEngine
+{
+public:
+    using result_type = typename Engine::result_type;
+    static constexpr result_type min() { return Engine::min(); }
+    static constexpr result_type max() { return Engine::max(); }
+
+    explicit AntitheticEngine(Engine &base) : base(base) {}
+
+    void first()
+    {
+        words.clear();
+        mirrored = false;
+    }
+
+    void second()
+    {
+        position = 0;
+        mirrored = true;
+    }
+
+    result_type operator()()
+    {
+        if (!mirrored)
+        {
+            result_type w = base();
+            words.push_back(w);
+            return w;
+        }
+        if (position < words.size()) return max() - (words[position++] - min());
+        return base();
+    }
+
+private:
+    Engine &base;
+    std::vector<result_type> words;
+    std::size_t position = 0;
+    bool mirrored = false;
+};
+
+// Statistics of pairs (y, c) where c has the known mean controlMean. The
+// estimate is mean(y) - b (mean(c) - controlMean) with b = Cov(y, c) /
+// Var(c) from the running co-moments; estimating b adds an O(1/n) bias,
+// negligible next to the standard error for any useful n.
+class ControlVariateStats
+{
+public:
+    explicit ControlVariateStats(double controlMean = 0.0) : mu(controlMean) {}
+
+    void add(double y, double c)
+    {
+        n++;
+        double dy = y - my;
+        double dc = c - mc;
+        my += dy / n;
+        mc += dc / n;
+        syy += dy * (y - my);
+        scc += dc * (c - mc);
+        syc += dy * (c - mc);
+    }
+
+    // Pairwise update of the co-moments, as RunningStats::merge.
+    void merge(const ControlVariateStats &other)
+    {
+        if (other.n == 0) return;
+        if (n == 0)
+        {
+            *this = other;
+            return;
+        }
+        double total = static_cast<double>(n + other.n);
+        double dy = other.my - my;
+        double dc = other.mc - mc;
+        double f = static_cast<double>(n) * other.n / total;
+        syy += other.syy + dy * dy * f;
+        scc += other.scc + dc * dc * f;
+        syc += other.syc + dy * dc * f;
+        my += dy * other.n / total;
+        mc += dc * other.n / total;
+        n += other.n;
+    }
+
+    long long count() const { return n; }
+    double coefficient() const { return scc > 0 ? syc / scc : 0.0; }
+    double correlation() const { return scc > 0 && syy > 0 ? syc / std::sqrt(scc * syy) : 0.0; }
+    double uncontrolledMean() const { return my; }
+    double mean() const { return my - coefficient() * (mc - mu); }
+    // Variance of the residual y - b c, with two degrees of freedom used
+    // for the mean and b.
+    double variance() const { return n > 2 ? (syy - coefficient() * syc) / (n - 2) : 0.0; }
+    double standardError() const { return n > 2 ? std::sqrt(variance() / n) : 0.0; }
+    double ciHalfWidth(double z = 1.96) const { return z * standardError(); }
+
+    // The members, for an archive (see OnlineStats.hpp).
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int)
+    {
+        ar &mu &n &my &mc &syy &scc &syc;
+    }
+
+private:
+    double mu;
+    long long n = 0;
+    double my = 0.0, mc = 0.0;
+    double syy = 0.0, scc = 0.0, syc = 0.0;
+};
+
+// Per-stratum statistics for strata with probabilities 'weights' (summing
+// to 1). The estimate is sum_k w_k mean_k, with variance
+// sum_k w_k^2 var_k / n_k; every stratum needs at least two observations.
+class StratifiedStats
+{
+public:
+    explicit StratifiedStats(std::vector<double> weights) : w(std::move(weights)), strata(w.size()) {}
+
+    void add(std::size_t stratum, double y) { strata[stratum].add(y); }
+
+    void merge(const StratifiedStats &other)
+    {
+        if (other.strata.size() != strata.size())
+            throw std::invalid_argument("cannot merge different stratifications");
+        for (std::size_t k = 0; k < strata.size(); k++) strata[k].merge(other.strata[k]);
+    }
+
+    std::size_t size() const { return strata.size(); }
+    double weight(std::size_t k) const { return w[k]; }
+    const RunningStats &stratum(std::size_t k) const { return strata[k]; }
+
+    long long count() const
+    {
+        long long n = 0;
+        for (const RunningStats &s : strata) n += s.count();
+        return n;
+    }
+
+    double mean() const
+    {
+        double m = 0.0;
+        for (std::size_t k = 0; k < strata.size(); k++) m += w[k] * strata[k].mean();
+        return m;
+    }
+
+    double standardError() const
+    {
+        double v = 0.0;
+        for (std::size_t k = 0; k < strata.size(); k++)
+        {
+            if (strata[k].count() > 1) v += w[k] * w[k] * strata[k].variance() / strata[k].count();
+        }
+        return std::sqrt(v);
+    }
+
+    double ciHalfWidth(double z = 1.96) const { return z * standardError(); }
+
+private:
+    std::vector<double> w;
+    std::vector<RunningStats> strata;
+};
+
+// n samples of sample(rng).
+template <class Rng, class Sample>
+RunningStats crudeEstimate(Sample &&sample, long long n, Rng &rng)
+{
+    RunningStats stats;
+    for (long long i = 0; i < n; i++) stats.add(sample(rng));
+    return stats;
+}
+
+// nPairs antithetic pairs; each observation is the average of a pair, so
+// count() is nPairs and 2 * nPairs samples are drawn. 'sample' must accept
+// an AntitheticEngine<Rng> (a generic lambda taking auto &rng does).
+template <class Rng, class Sample>
+RunningStats antitheticEstimate(Sample &&sample, long long nPairs, Rng &rng)
+{
+    AntitheticEngine<Rng> pair(rng);
+    RunningStats stats;
+    for (long long i = 0; i < nPairs; i++)
+    {
+        pair.first();
+        double y = sample(pair);
+        pair.second();
+        stats.add(0.5 * (y + sample(pair)));
+    }
+    return stats;
+}
+
+// n samples of sample(rng), which returns the pair (y, c).
+template <class Rng, class Sample>
+ControlVariateStats controlVariateEstimate(Sample &&sample, double controlMean, long long n, Rng &rng)
+{
+    ControlVariateStats stats(controlMean);
+    for (long long i = 0; i < n; i++)
+    {
+        std::pair<double, double> yc = sample(rng);
+        stats.add(yc.first, yc.second);
+    }
+    return stats;
+}
+
+// About n samples spread over the strata in proportion to their
+// probabilities (at least two each); sample(k, rng) draws y conditionally
+// on stratum k.
+template <class Rng, class Sample>
+StratifiedStats stratifiedEstimate(Sample &&sample, const std::vector<double> &weights, long long n, Rng &rng)
+{
+    StratifiedStats stats(weights);
+    for (std::size_t k = 0; k < weights.size(); k++)
+    {
+        long long nk = std::max(2LL, std::llround(weights[k] * n));
+        for (long long i = 0; i < nk; i++) stats.add(k, sample(k, rng));
+    }
+    return stats;
+}
+
+// n samples of value(x) * likelihoodRatio(x), x = draw(rng) drawn from the
+// proposal; likelihoodRatio is target density / proposal density.
+template <class Rng, class Draw, class Value, class LikelihoodRatio>
+RunningStats importanceEstimate(Draw &&draw, Value &&value, LikelihoodRatio &&likelihoodRatio, long long n, Rng &rng)
+{
+    RunningStats stats;
+    for (long long i = 0; i < n; i++)
+    {
+        auto x = draw(rng);
+        stats.add(value(x) * likelihoodRatio(x));
+    }
+    return stats;
+}
+
+// Runs block(b, rng, stats) for blocks b = 0..nBlocks-1 on nThreads threads,
+// block b on stream b of 'seed' filling its own copy of 'empty', and merges
+// the blocks in order.
+template <class Engine = Xoshiro256StarStar, class Stats, class Block>
+Stats runInBlocks(const Stats &empty, long long nBlocks, std::uint64_t seed, unsigned nThreads, Block &&block)
+{
+    if (nThreads == 0) nThreads = 1;
+    std::vector<Engine> blockRng = makeStreamsOf<Engine>(seed, 0, static_cast<std::size_t>(nBlocks));
+    std::vector<Stats> blockStats(static_cast<std::size_t>(nBlocks), empty);
+    std::atomic<long long> next(0);
+    auto worker = [&]() {
+        for (long long b = next++; b < nBlocks; b = next++) block(b, blockRng[b], blockStats[b]);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers) w.join();
+
+    Stats result = empty;
+    for (const Stats &s : blockStats) result.merge(s);
+    return result;
+}
+
+// One row of an EstimatorComparison.
+struct EstimatorResult
+{
+    std::string method;
+    double estimate = 0.0;
+    double standardError = 0.0;
+    long long samples = 0;   // integrand evaluations
+    double cpuSeconds = 0.0;
+
+    double variancePerSample() const { return standardError * standardError * samples; }
+};
+
+class EstimatorComparison
+{
+public:
+    // Runs estimate() (returning any of the statistics above) and records
+    // its result; 'samplesPerCount' is the number of integrand evaluations
+    // behind each observation (2 for antithetic pairs).
+    template <class Run>
+    const EstimatorResult &run(const std::string &method, Run &&estimate, long long samplesPerCount = 1)
+    {
+        std::clock_t start = std::clock();
+        auto stats = estimate();
+        double cpu = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+        results.push_back({method, stats.mean(), stats.standardError(), stats.count() * samplesPerCount, cpu});
+        return results.back();
+    }
+
+    const std::vector<EstimatorResult> &rows() const { return results; }
+
+    // Speedup of row i over row 0 for equal error per CPU second.
+    double speedup(std::size_t i) const
+    {
+        const EstimatorResult &crude = results.front(), &r = results[i];
+        double work = r.standardError * r.standardError * r.cpuSeconds;
+        return work > 0 ? crude.standardError * crude.standardError * crude.cpuSeconds / work : 0.0;
+    }
+
+    void print(std::ostream &out) const
+    {
+        std::ostringstream text;
+        text << std::left << std::setw(14) << "method" << std::right << std::setw(14) << "estimate" << std::setw(12)
+             << "std error" << std::setw(12) << "var/sample" << std::setw(10) << "CPU s" << std::setw(10)
+             << "speedup" << "\n";
+        for (std::size_t i = 0; i < results.size(); i++)
+        {
+            const EstimatorResult &r = results[i];
+            text << std::left << std::setw(14) << r.method << std::right << std::setprecision(8) << std::setw(14)
+                 << r.estimate << std::setprecision(3) << std::setw(12) << r.standardError << std::setw(12)
+                 << r.variancePerSample() << std::setw(10) << r.cpuSeconds << std::setw(9) << speedup(i) << "x\n";
+        }
+        out << text.str();
+    }
+
+private:
+    std::vector<EstimatorResult> results;
+};
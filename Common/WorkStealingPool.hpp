@@ -0,0 +1,125 @@
+/************************************************************
+ * Work-stealing execution of a fixed set of independent tasks.
+ *
+ * runWorkStealing(nTasks, nThreads, task) calls task(k, worker)
+ * once for every k in [0, nTasks). Worker w starts with the
+ * contiguous range of tasks w * nTasks / nThreads onwards in its
+ * own deque and takes them from the back; a worker whose deque
+ * runs dry steals the front half of another worker's deque. With
+ * tasks of very different lengths (a grid whose points differ in
+ * run length by orders of magnitude) the threads therefore stay
+ * busy until the last task, where a shared counter over the task
+ * list would hand later long tasks to whoever comes first and a
+ * static split would leave most threads idle.
+ *
+ * Which worker runs a task depends on timing, so a task must not
+ * depend on its worker: give task k its own RNG stream and its
+ * own output slot, and combine the outputs in task order. A
+ * task must not throw: an exception leaving a worker thread ends
+ * the program, so catch inside the task and report afterwards.
+ ************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Per-worker counts of one run, for judging the load balance.
+struct WorkStealingStats
+{
+    std::vector<long long> executed;   // tasks run by each worker
+    std::vector<long long> stolen;     // tasks each worker took from others
+    long long steals = 0;              // successful steal attempts
+
+    long long totalStolen() const
+    {
+        long long n = 0;
+        for (long long s : stolen) n += s;
+        return n;
+    }
+};
+
+namespace workstealing
+{
+struct alignas(64) TaskDeque
+{
+    std::mutex lock;
+    std::deque<long long> tasks;
+};
+} // namespace workstealing
+
+template <class Task>
+WorkStealingStats runWorkStealing(long long nTasks, unsigned nThreads, Task &&task)
+{
+    if (nThreads == 0) nThreads = 1;
+    if (nTasks < static_cast<long long>(nThreads)) nThreads = static_cast<unsigned>(nTasks > 0 ? nTasks : 1);
+
+    std::vector<workstealing::TaskDeque> deques(nThreads);
+    for (unsigned w = 0; w < nThreads; w++)
+    {
+        long long first = nTasks * w / nThreads, last = nTasks * (w + 1) / nThreads;
+        for (long long k = first; k < last; k++) deques[w].tasks.push_back(k);
+    }
+
+    WorkStealingStats stats;
+    stats.executed.assign(nThreads, 0);
+    stats.stolen.assign(nThreads, 0);
+    std::vector<long long> steals(nThreads, 0);
+
+    auto worker = [&](unsigned w) {
+        workstealing::TaskDeque &own = deques[w];
+        std::uint64_t victimState = 0x9e3779b97f4a7c15ULL * (w + 1);   // victim order, per worker
+        for (;;)
+        {
+            long long k = -1;
+            {
+                std::lock_guard<std::mutex> guard(own.lock);
+                if (!own.tasks.empty())
+                {
+                    k = own.tasks.back();
+                    own.tasks.pop_back();
+                }
+            }
+            if (k < 0)
+            {
+                // Steal half of the first non-empty deque, starting at a
+                // pseudo-random victim. The stolen tasks go to the own deque
+                // except the one run right away. Tasks are never created, so
+                // once every deque is empty the work is done.
+                std::vector<long long> loot;
+                victimState ^= victimState << 13;
+                victimState ^= victimState >> 7;
+                victimState ^= victimState << 17;
+                for (unsigned i = 0; i < nThreads && loot.empty(); i++)
+                {
+                    unsigned v = static_cast<unsigned>((victimState + i) % nThreads);
+                    if (v == w) continue;
+                    std::lock_guard<std::mutex> guard(deques[v].lock);
+                    std::deque<long long> &from = deques[v].tasks;
+                    std::size_t n = (from.size() + 1) / 2;
+                    loot.assign(from.begin(), from.begin() + static_cast<std::ptrdiff_t>(n));
+                    from.erase(from.begin(), from.begin() + static_cast<std::ptrdiff_t>(n));
+                }
+                if (loot.empty()) return;
+                steals[w]++;
+                stats.stolen[w] += static_cast<long long>(loot.size());
+                k = loot.back();
+                loot.pop_back();
+                std::lock_guard<std::mutex> guard(own.lock);
+                own.tasks.insert(own.tasks.end(), loot.begin(), loot.end());
+            }
+            task(k, w);
+            stats.executed[w]++;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker, w);
+    worker(0);
+    for (auto &t : workers) t.join();
+
+    for (long long s : steals) stats.steals += s;
+    return stats;
+}
@@ -0,0 +1,83 @@
+"""Reader for the binary trace files written by Common/TraceFile.hpp.
+
+    meta, columns = read_trace("walk.trace")
+    positions = columns["position"]
+
+The file is mapped with numpy.memmap. A plain column stored in a single
+chunk is returned as a view of the mapping, so it is not copied until it
+is used; columns spread over several chunks are concatenated, which copies
+them once. Delta-encoded columns are decoded with a cumulative sum (in
+float64 for float columns, int64 for integer columns).
+"""
+import struct
+
+import numpy as np
+
+MAGIC = b"SSTRACE1"
+HEADER = struct.Struct("<8sIIQQQQII")
+COLUMN = struct.Struct("<32sBB6x")
+CHUNK = struct.Struct("<QQ")
+
+DTYPES = {0: np.float64, 1: np.float32, 2: np.int64, 3: np.int32, 4: np.int8}
+DELTA = 1
+
+
+def _pad8(n):
+    return (n + 7) // 8 * 8
+
+
+def read_trace_meta(path):
+    """Seed, parameters, columns and chunk layout of a trace file."""
+    with open(path, "rb") as f:
+        magic, version, n_columns, seed, n_rows, n_chunks, data_offset, params_bytes, _ = \
+            HEADER.unpack(f.read(HEADER.size))
+        if magic != MAGIC:
+            raise ValueError(f"{path} is not a trace file")
+        if version != 1:
+            raise ValueError(f"unsupported trace version {version}")
+
+        columns = []
+        for _ in range(n_columns):
+            name, dtype, encoding = COLUMN.unpack(f.read(COLUMN.size))
+            columns.append((name.rstrip(b"\0").decode(), DTYPES[dtype], encoding))
+
+        params = {}
+        for line in f.read(params_bytes).decode().splitlines():
+            key, _, value = line.partition("=")
+            params[key] = float(value)
+
+        chunks = []
+        offset = data_offset
+        for _ in range(n_chunks):
+            f.seek(offset)
+            rows, payload = CHUNK.unpack(f.read(CHUNK.size))
+            chunks.append((offset + CHUNK.size, rows))
+            offset += CHUNK.size + payload
+
+    return {"seed": seed, "rows": n_rows, "params": params, "columns": columns, "chunks": chunks}
+
+
+def read_trace(path):
+    """(meta, {column name: numpy array}) with delta columns decoded."""
+    meta = read_trace_meta(path)
+    raw = np.memmap(path, dtype=np.uint8, mode="r")
+
+    parts = {name: [] for name, _, _ in meta["columns"]}
+    for start, rows in meta["chunks"]:
+        offset = start
+        for name, dtype, _ in meta["columns"]:
+            nbytes = rows * np.dtype(dtype).itemsize
+            parts[name].append(raw[offset:offset + nbytes].view(dtype))
+            offset += _pad8(nbytes)
+
+    columns = {}
+    for name, dtype, encoding in meta["columns"]:
+        if len(parts[name]) == 1:
+            values = parts[name][0]
+        else:
+            values = np.concatenate(parts[name]) if parts[name] else np.empty(0, dtype)
+        if encoding == DELTA:
+            wide = np.float64 if np.issubdtype(dtype, np.floating) else np.int64
+            values = np.cumsum(values, dtype=wide)
+        columns[name] = values
+    return meta, columns
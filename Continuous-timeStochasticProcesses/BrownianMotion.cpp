@@ -0,0 +1,418 @@
+/************************************************************
+ * Native path engine for Brownian motion and general SDEs:
+ *  1) Brownian motion with drift, many paths per call
+ *  2) Euler-Maruyama for dX = a(t, X) dt + b(t, X) dW, keeping
+ *     only functionals of each path (final value, maximum,
+ *     minimum, first crossing time of a level)
+ *  3) Quasi-Monte Carlo paths: Brownian-bridge construction
+ *     driven by scrambled Sobol points, with randomized-QMC
+ *     error estimates for path expectations
+ *
+ * Gaussian increments come from fillStandardNormals (vectorized
+ * Box-Muller) in blocks. Paths are grouped into blocks of
+ * PATH_BLOCK; block b always uses stream b of the seed (or
+ * Sobol points b * PATH_BLOCK onwards), so results do not
+ * depend on the number of threads.
+ *
+ * Compile example:
+ *   g++ -std=c++17 -O3 -march=native -ffp-contract=off -pthread BrownianMotion.cpp -o bm
+ * Run:
+ *   ./bm
+ ************************************************************/
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <thread>
+#include <utility>
+
+#include "../Common/RandomStreams.hpp"
+#include "../Common/NormalVariates.hpp"
+#include "../Common/OnlineStats.hpp"
+#include "../Common/Sobol.hpp"
+
+// Paths per RNG stream, and per lockstep block in the SDE engine.
+constexpr long long PATH_BLOCK = 256;
+
+// Steps generated at a time along one path (fits in L1 with the normals).
+constexpr std::size_t STEP_CHUNK = 1024;
+
+// Runs body(b) for every block b = 0..nBlocks-1 on nThreads threads.
+template <class Body>
+void forEachBlock(long long nBlocks, unsigned nThreads, Body &&body)
+{
+    if (nThreads == 0) nThreads = 1;
+    std::atomic<long long> next(0);
+    auto worker = [&]() {
+        for (long long b = next++; b < nBlocks; b = next++) body(b);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers) w.join();
+}
+
+// Runs body(b, rng) for every block b = 0..nBlocks-1 on nThreads threads,
+// with rng the engine of stream b of 'seed'.
+template <class Engine, class Body>
+void forEachPathBlock(long long nBlocks, std::uint64_t seed, unsigned nThreads, Body &&body)
+{
+    std::vector<Engine> blockRng = makeStreamsOf<Engine>(seed, 0, static_cast<std::size_t>(nBlocks));
+    forEachBlock(nBlocks, nThreads, [&](long long b) { body(b, blockRng[b]); });
+}
+
+// 1) Brownian motion paths
+//    nPaths paths of mu * t + sigma * B(t) on the grid t_k = k T / M,
+//    stored row by row: value(p, k) = values[p * (M + 1) + k].
+struct BrownianPaths
+{
+    long long nPaths = 0;
+    long long M = 0;
+    double T = 0.0;
+    std::vector<double> values;
+
+    const double *path(long long p) const { return values.data() + p * (M + 1); }
+    double time(long long k) const { return T * static_cast<double>(k) / static_cast<double>(M); }
+};
+
+//    Every path is built in chunks of STEP_CHUNK steps: the normals are
+//    written straight into the row, scaled to increments in one vectorized
+//    pass, and then summed up in place, carrying the last value over to
+//    the next chunk.
+template <class Engine = Xoshiro256StarStar>
+BrownianPaths simulateBrownianPaths(long long nPaths, double T, long long M, std::uint64_t seed, unsigned nThreads,
+                                    double mu = 0.0, double sigma = 1.0)
+{
+    BrownianPaths paths;
+    paths.nPaths = nPaths;
+    paths.M = M;
+    paths.T = T;
+    paths.values.resize(static_cast<std::size_t>(nPaths * (M + 1)));
+
+    const double dt = T / M;
+    const double drift = mu * dt, scale = sigma * std::sqrt(dt);
+    const long long nBlocks = (nPaths + PATH_BLOCK - 1) / PATH_BLOCK;
+    forEachPathBlock<Engine>(nBlocks, seed, nThreads, [&](long long b, Engine &rng) {
+        for (long long p = b * PATH_BLOCK; p < std::min(nPaths, (b + 1) * PATH_BLOCK); p++)
+        {
+            double *row = paths.values.data() + p * (M + 1);
+            row[0] = 0.0;
+            for (long long k = 1; k <= M; k += STEP_CHUNK)
+            {
+                std::size_t n = static_cast<std::size_t>(std::min<long long>(STEP_CHUNK, M + 1 - k));
+                double *chunk = row + k;
+                fillStandardNormals(rng, chunk, n);
+                for (std::size_t i = 0; i < n; i++) chunk[i] = drift + scale * chunk[i];
+                double value = row[k - 1];
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    value += chunk[i];
+                    chunk[i] = value;
+                }
+            }
+        }
+    });
+    return paths;
+}
+
+// 2) Euler-Maruyama for dX = a(t, X) dt + b(t, X) dW
+//    Streaming version for one path: visit(k, t_k, X_k) for k = 0..M,
+//    increments drawn STEP_CHUNK at a time, nothing stored.
+template <class Drift, class Diffusion, class Rng, class Visitor>
+void eulerMaruyama(double x0, double T, long long M, Drift &&a, Diffusion &&b, Rng &rng, Visitor &&visit)
+{
+    const double dt = T / M, sqrtDt = std::sqrt(dt);
+    double z[STEP_CHUNK];
+    double x = x0;
+    visit(0LL, 0.0, x);
+    for (long long k = 1; k <= M; k += STEP_CHUNK)
+    {
+        std::size_t n = static_cast<std::size_t>(std::min<long long>(STEP_CHUNK, M + 1 - k));
+        fillStandardNormals(rng, z, n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double t = (k - 1 + static_cast<long long>(i)) * dt;
+            x += a(t, x) * dt + b(t, x) * sqrtDt * z[i];
+            visit(k + static_cast<long long>(i), t + dt, x);
+        }
+    }
+}
+
+//    What is kept of every path.
+struct PathFunctionals
+{
+    double finalValue;
+    double maxValue;
+    double minValue;
+    double crossingTime;   // first grid time on the far side of 'level' from x0, -1 if never
+};
+
+//    Functionals of nPaths Euler-Maruyama paths. The PATH_BLOCK paths of a
+//    block advance together: per time step one call fills PATH_BLOCK
+//    normals and a single loop over the block updates all states and
+//    functionals, which the compiler vectorizes when a and b inline.
+template <class Engine = Xoshiro256StarStar, class Drift, class Diffusion>
+std::vector<PathFunctionals> simulateSDEFunctionals(double x0, double T, long long M, Drift a, Diffusion b,
+                                                    double level, long long nPaths, std::uint64_t seed,
+                                                    unsigned nThreads)
+{
+    std::vector<PathFunctionals> out(static_cast<std::size_t>(nPaths));
+    const double dt = T / M, sqrtDt = std::sqrt(dt);
+    const double side = x0 < level ? 1.0 : -1.0;   // crossing means side * (x - level) >= 0
+    const double initialCrossing = side * (x0 - level) >= 0 ? 0.0 : -1.0;
+    const long long nBlocks = (nPaths + PATH_BLOCK - 1) / PATH_BLOCK;
+
+    forEachPathBlock<Engine>(nBlocks, seed, nThreads, [&](long long blk, Engine &rng) {
+        const long long first = blk * PATH_BLOCK;
+        const std::size_t n = static_cast<std::size_t>(std::min(PATH_BLOCK, nPaths - first));
+        double x[PATH_BLOCK], hi[PATH_BLOCK], lo[PATH_BLOCK], cross[PATH_BLOCK], z[PATH_BLOCK];
+        std::fill(x, x + n, x0);
+        std::fill(hi, hi + n, x0);
+        std::fill(lo, lo + n, x0);
+        std::fill(cross, cross + n, initialCrossing);
+
+        for (long long k = 0; k < M; k++)
+        {
+            const double t = k * dt, tNext = (k + 1) * dt;
+            fillStandardNormals(rng, z, n);
+            for (std::size_t i = 0; i < n; i++)
+            {
+                const double xi = x[i] + a(t, x[i]) * dt + b(t, x[i]) * sqrtDt * z[i];
+                x[i] = xi;
+                hi[i] = std::max(hi[i], xi);
+                lo[i] = std::min(lo[i], xi);
+                cross[i] = (cross[i] < 0 && side * (xi - level) >= 0) ? tNext : cross[i];
+            }
+        }
+        for (std::size_t i = 0; i < n; i++) out[first + i] = {x[i], hi[i], lo[i], cross[i]};
+    });
+    return out;
+}
+
+// 3) Brownian bridge and quasi-Monte Carlo paths
+//    The bridge builds the grid values B(t_1..t_M) from M standard normals
+//    coarse to fine: z[0] sets B(T), z[1] the midpoint given B(0) and B(T),
+//    and so on, always splitting the oldest remaining interval. Fed with
+//    Sobol points, the first (best distributed) coordinates then carry most
+//    of the variance of the path.
+class BrownianBridge
+{
+public:
+    BrownianBridge(long long M, double T) : M(M), rootT(std::sqrt(T))
+    {
+        const double dt = T / M;
+        std::vector<std::pair<long long, long long>> intervals{{0, M}};
+        for (std::size_t head = 0; head < intervals.size(); head++)
+        {
+            const long long j = intervals[head].first, k = intervals[head].second;
+            if (k - j < 2) continue;
+            const long long l = j + (k - j) / 2;
+            point.push_back(l);
+            left.push_back(j);
+            right.push_back(k);
+            leftWeight.push_back(static_cast<double>(k - l) / (k - j));
+            rightWeight.push_back(static_cast<double>(l - j) / (k - j));
+            stdDev.push_back(std::sqrt(dt * (l - j) * (k - l) / (k - j)));
+            intervals.push_back({j, l});
+            intervals.push_back({l, k});
+        }
+    }
+
+    long long steps() const { return M; }
+
+    // w[0..M] = B(t_0..t_M) from the normals z[0..M).
+    void buildPath(const double *z, double *w) const
+    {
+        w[0] = 0.0;
+        w[M] = rootT * z[0];
+        for (std::size_t i = 0; i < point.size(); i++)
+            w[point[i]] = leftWeight[i] * w[left[i]] + rightWeight[i] * w[right[i]] + stdDev[i] * z[i + 1];
+    }
+
+private:
+    long long M;
+    double rootT;
+    std::vector<long long> point, left, right;   // value set by normal i + 1, and its neighbours
+    std::vector<double> leftWeight, rightWeight, stdDev;
+};
+
+//    Path p of mu * t + sigma * B(t) from Sobol point p of 'sobol' (of
+//    dimension M), written to w[0..M]; z is scratch space for M normals.
+inline void sobolBridgePath(SobolSequence &sobol, const BrownianBridge &bridge, double T, double mu, double sigma,
+                            double *z, double *w)
+{
+    const long long M = bridge.steps();
+    sobol.next(z);
+    for (long long k = 0; k < M; k++) z[k] = inverseNormalCdf(z[k]);
+    bridge.buildPath(z, w);
+    for (long long k = 0; k <= M; k++) w[k] = mu * (T * k / M) + sigma * w[k];
+}
+
+//    nPaths QMC paths: the Sobol sequence scrambled by 'scrambler', path p
+//    built from point p. Blocks of PATH_BLOCK paths start with skipTo, so
+//    the paths do not depend on nThreads.
+inline BrownianPaths simulateBrownianPathsQMC(long long nPaths, double T, long long M, Xoshiro256StarStar scrambler,
+                                              unsigned nThreads, double mu = 0.0, double sigma = 1.0)
+{
+    BrownianPaths paths;
+    paths.nPaths = nPaths;
+    paths.M = M;
+    paths.T = T;
+    paths.values.resize(static_cast<std::size_t>(nPaths * (M + 1)));
+
+    const SobolSequence sobol(static_cast<int>(M), scrambler);
+    const BrownianBridge bridge(M, T);
+    const long long nBlocks = (nPaths + PATH_BLOCK - 1) / PATH_BLOCK;
+    forEachBlock(nBlocks, nThreads, [&](long long b) {
+        SobolSequence points = sobol;
+        points.skipTo(static_cast<std::uint64_t>(b * PATH_BLOCK));
+        std::vector<double> z(static_cast<std::size_t>(M));
+        for (long long p = b * PATH_BLOCK; p < std::min(nPaths, (b + 1) * PATH_BLOCK); p++)
+            sobolBridgePath(points, bridge, T, mu, sigma, z.data(), paths.values.data() + p * (M + 1));
+    });
+    return paths;
+}
+
+//    Randomized QMC estimate of E[f(w)], w[0..M] a path of mu * t +
+//    sigma * B(t): 'replicates' independent scramblings of the Sobol
+//    sequence (replicate r scrambled by stream r of 'seed'), nPoints paths
+//    each. The result holds the replicate means; as they are i.i.d. and
+//    unbiased, mean() is the estimate and standardError() / ciHalfWidth()
+//    its error.
+template <class PathFunction>
+RunningStats estimatePathMeanRQMC(PathFunction f, double T, long long M, long long nPoints, long long replicates,
+                                  std::uint64_t seed, unsigned nThreads, double mu = 0.0, double sigma = 1.0)
+{
+    std::vector<Xoshiro256StarStar> scramblers = makeStreamsOf<Xoshiro256StarStar>(seed, 0, replicates);
+    std::vector<SobolSequence> sobol;
+    for (long long r = 0; r < replicates; r++) sobol.emplace_back(static_cast<int>(M), scramblers[r]);
+    const BrownianBridge bridge(M, T);
+
+    // Task r * nBlocks + b sums f over block b of replicate r.
+    const long long nBlocks = (nPoints + PATH_BLOCK - 1) / PATH_BLOCK;
+    std::vector<double> blockSums(static_cast<std::size_t>(replicates * nBlocks));
+    forEachBlock(replicates * nBlocks, nThreads, [&](long long task) {
+        const long long r = task / nBlocks, b = task % nBlocks;
+        SobolSequence points = sobol[r];
+        points.skipTo(static_cast<std::uint64_t>(b * PATH_BLOCK));
+        std::vector<double> z(static_cast<std::size_t>(M)), w(static_cast<std::size_t>(M + 1));
+        double sum = 0.0;
+        for (long long p = b * PATH_BLOCK; p < std::min(nPoints, (b + 1) * PATH_BLOCK); p++)
+        {
+            sobolBridgePath(points, bridge, T, mu, sigma, z.data(), w.data());
+            sum += f(static_cast<const double *>(w.data()));
+        }
+        blockSums[task] = sum;
+    });
+
+    RunningStats means;
+    for (long long r = 0; r < replicates; r++)
+    {
+        double sum = 0.0;
+        for (long long b = 0; b < nBlocks; b++) sum += blockSums[r * nBlocks + b];
+        means.add(sum / nPoints);
+    }
+    return means;
+}
+
+//    Plain Monte Carlo counterpart with i.i.d. increments: the statistics
+//    of f over nPaths paths, merged block by block.
+template <class PathFunction, class Engine = Xoshiro256StarStar>
+RunningStats estimatePathMeanMC(PathFunction f, double T, long long M, long long nPaths, std::uint64_t seed,
+                                unsigned nThreads, double mu = 0.0, double sigma = 1.0)
+{
+    const double dt = T / M, drift = mu * dt, scale = sigma * std::sqrt(dt);
+    const long long nBlocks = (nPaths + PATH_BLOCK - 1) / PATH_BLOCK;
+    std::vector<RunningStats> blockStats(static_cast<std::size_t>(nBlocks));
+    forEachPathBlock<Engine>(nBlocks, seed, nThreads, [&](long long b, Engine &rng) {
+        std::vector<double> w(static_cast<std::size_t>(M + 1));
+        for (long long p = b * PATH_BLOCK; p < std::min(nPaths, (b + 1) * PATH_BLOCK); p++)
+        {
+            w[0] = 0.0;
+            fillStandardNormals(rng, w.data() + 1, static_cast<std::size_t>(M));
+            for (long long k = 1; k <= M; k++) w[k] = w[k - 1] + drift + scale * w[k];
+            blockStats[b].add(f(static_cast<const double *>(w.data())));
+        }
+    });
+    RunningStats stats;
+    for (const RunningStats &s : blockStats) stats.merge(s);
+    return stats;
+}
+
+int main()
+{
+    unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+    using clock = std::chrono::steady_clock;
+
+    // ============ 1) Standard Brownian motion, T = 8, M = 1000 =============
+    auto t0 = clock::now();
+    BrownianPaths bm = simulateBrownianPaths(2000, 8.0, 1000, 12345, nThreads);
+    double sec = std::chrono::duration<double>(clock::now() - t0).count();
+    RunningStats finalB;
+    for (long long p = 0; p < bm.nPaths; p++) finalB.add(bm.path(p)[bm.M]);
+    std::cout << bm.nPaths << " Brownian paths of " << bm.M << " steps in " << sec << " s ("
+              << bm.nPaths * bm.M / sec / 1e6 << " Msteps/s); Var B(8) = " << finalB.variance()
+              << " (exact 8)\n";
+
+    // ============ 2) Geometric Brownian motion, functionals only ==========
+    // dX = 0.05 X dt + 0.2 X dW, X_0 = 100, one year of 252 steps, level 120.
+    const double mu = 0.05, sigma = 0.2;
+    t0 = clock::now();
+    std::vector<PathFunctionals> gbm = simulateSDEFunctionals(
+        100.0, 1.0, 252, [=](double, double x) { return mu * x; }, [=](double, double x) { return sigma * x; },
+        120.0, 1000000, 12345, nThreads);
+    sec = std::chrono::duration<double>(clock::now() - t0).count();
+
+    RunningStats finalX, crossedTime;
+    long long crossed = 0;
+    for (const PathFunctionals &f : gbm)
+    {
+        finalX.add(f.finalValue);
+        if (f.crossingTime >= 0)
+        {
+            crossed++;
+            crossedTime.add(f.crossingTime);
+        }
+    }
+    std::cout << gbm.size() << " GBM paths in " << sec << " s: E[X_T] = " << finalX.mean() << " +- "
+              << finalX.ciHalfWidth() << " (exact " << 100.0 * std::exp(mu) << "), P(max >= 120) = "
+              << static_cast<double>(crossed) / gbm.size() << ", mean crossing time " << crossedTime.mean() << "\n";
+
+    // ============ 3) One Ornstein-Uhlenbeck path, streamed ================
+    // dX = -X dt + dW from X_0 = 0: Var X_T -> 1/2, so the time average of
+    // X^2 over a long path is close to 1/2.
+    Xoshiro256StarStar rng = makeStream(12345, 0);
+    double sumSquares = 0.0;
+    long long steps = 10000000;
+    eulerMaruyama(0.0, 1e5, steps, [](double, double x) { return -x; }, [](double, double) { return 1.0; }, rng,
+                  [&](long long, double, double x) { sumSquares += x * x; });
+    std::cout << "Ornstein-Uhlenbeck time average of X^2 = " << sumSquares / (steps + 1) << " (stationary 0.5)\n";
+
+    // ============ 4) Asian call: Monte Carlo vs bridge + Sobol ============
+    // S_t = 100 exp((r - sigma^2/2) t + sigma B(t)), payoff
+    // exp(-r) max(mean of S over 64 dates - 100, 0). Both estimators use
+    // 16 * 4096 paths; RQMC's error comes from its 16 scramblings.
+    const double r = 0.05, vol = 0.2;
+    auto asianCall = [=](const double *w) {
+        double sum = 0.0;
+        for (int k = 1; k <= 64; k++) sum += 100.0 * std::exp(w[k]);
+        return std::exp(-r) * std::max(sum / 64 - 100.0, 0.0);
+    };
+    t0 = clock::now();
+    RunningStats mc = estimatePathMeanMC(asianCall, 1.0, 64, 16 * 4096, 12345, nThreads, r - 0.5 * vol * vol, vol);
+    double mcSec = std::chrono::duration<double>(clock::now() - t0).count();
+    t0 = clock::now();
+    RunningStats qmc = estimatePathMeanRQMC(asianCall, 1.0, 64, 4096, 16, 12345, nThreads, r - 0.5 * vol * vol, vol);
+    double qmcSec = std::chrono::duration<double>(clock::now() - t0).count();
+    std::cout << "Asian call, MC  : " << mc.mean() << " +- " << mc.ciHalfWidth() << " (" << mcSec << " s)\n";
+    std::cout << "Asian call, RQMC: " << qmc.mean() << " +- " << qmc.ciHalfWidth() << " (" << qmcSec
+              << " s), variance reduction "
+              << (mc.standardError() * mc.standardError()) / (qmc.standardError() * qmc.standardError()) << "x\n";
+    return 0;
+}
@@ -1,20 +1,76 @@
 import numpy as np
 import matplotlib.pyplot as plt
 
-def simulate_brownian_motion_1d(T=1.0, M=1000):
+def simulate_brownian_motion_1d(T=1.0, M=1000, qmc=False, seed=None):
     """
     Simulates a 1D standard Brownian motion B(t) for t in [0, T] using M steps.
+    With qmc=True the path is built by Brownian-bridge refinement from one
+    scrambled Sobol point instead of i.i.d. increments (for many paths use
+    simulate_brownian_paths_qmc, which is where QMC pays off).
     Returns:
         times: array of shape (M+1,)
         B:     array of shape (M+1,)
     """
     dt = T / M
     times = np.linspace(0, T, M + 1)
+    if qmc:
+        return times, simulate_brownian_paths_qmc(T, M, 1, seed)[0]
     increments = np.random.normal(loc=0.0, scale=np.sqrt(dt), size=M)
     B = np.zeros(M + 1)
     B[1:] = np.cumsum(increments)
     return times, B
 
+def brownian_bridge(Z, T):
+    """
+    Turns standard normals Z of shape (n_paths, M) into Brownian paths on
+    t_k = k T / M, coarse to fine: Z[:, 0] sets B(T), Z[:, 1] the midpoint
+    B(T/2), and so on, always splitting the oldest remaining interval (the
+    same order as BrownianBridge in BrownianMotion.cpp).
+    Returns:
+        B: array of shape (n_paths, M+1), B[:, 0] = 0
+    """
+    n_paths, M = Z.shape
+    dt = T / M
+    B = np.zeros((n_paths, M + 1))
+    B[:, M] = np.sqrt(T) * Z[:, 0]
+    intervals = [(0, M)]
+    i = 1
+    for j, k in intervals:
+        if k - j < 2:
+            continue
+        l = j + (k - j) // 2
+        B[:, l] = ((k - l) * B[:, j] + (l - j) * B[:, k]) / (k - j) \
+            + np.sqrt(dt * (l - j) * (k - l) / (k - j)) * Z[:, i]
+        i += 1
+        intervals.append((j, l))
+        intervals.append((l, k))
+    return B
+
+def simulate_brownian_paths_qmc(T=1.0, M=1000, n_paths=1024, seed=None):
+    """
+    n_paths standard Brownian paths from a scrambled Sobol sequence of
+    dimension M, each point mapped to normals with the inverse normal CDF
+    and to a path with brownian_bridge. n_paths should be a power of 2.
+    Returns:
+        B: array of shape (n_paths, M+1)
+    """
+    from scipy.stats import norm, qmc
+    U = qmc.Sobol(d=M, scramble=True, seed=seed).random(n_paths)
+    return brownian_bridge(norm.ppf(U), T)
+
+def rqmc_estimate(f, T=1.0, M=64, n_paths=4096, replicates=16, seed=None):
+    """
+    Randomized-QMC estimate of E[f(B)], f mapping paths of shape
+    (n_paths, M+1) to n_paths values: 'replicates' independent scramblings,
+    whose i.i.d. means give the estimate and its standard error.
+    Returns:
+        (estimate, standard error)
+    """
+    rng = np.random.default_rng(seed)
+    means = np.array([np.mean(f(simulate_brownian_paths_qmc(T, M, n_paths, rng)))
+                      for _ in range(replicates)])
+    return means.mean(), means.std(ddof=1) / np.sqrt(replicates)
+
 def simulate_brownian_motion_2d(T=1.0, M=1000):
     """
     Simulates a 2D standard Brownian motion (X(t), Y(t)) for t in [0, T].
@@ -4,113 +4,90 @@
  *  2) Non-homogeneous Poisson process simulation (thinning)
  *  3) Compound Poisson process simulation
  *
- * Compile example:
- *   g++ -std=c++17 poisson_all.cpp -o poisson_all
+ * Compile example (or build target poisson with CMake):
+ *   g++ -std=c++17 -O3 -march=native -pthread PoissonProcess.cpp -o poisson
  * Run:
- *   ./poisson_all
+ *   ./poisson
  ************************************************************/
 #include <iostream>
 #include <random>
 #include <vector>
 #include <cmath>
-#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+
+#include "PoissonProcess.hpp"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
  
- // 1) Homogeneous Poisson Process
- //    Returns a vector of arrival times that occur before time T.
- std::vector<double> simulateHomogeneousPoisson(double lambda, double T, std::mt19937 &rng)
+ // Example rate function for non-homogeneous process
+ double exampleLambda(double t)
  {
-     std::vector<double> arrivalTimes;
-     // exponential_distribution(rate) means average interarrival time = 1/lambda
-     std::exponential_distribution<double> expDist(lambda);
- 
-     double t = 0.0;
-     // Generate arrivals until time exceeds T
-     while (true)
-     {
-         double dt = expDist(rng); // next interarrival time
-         t += dt;
-         if (t > T) break;
-         arrivalTimes.push_back(t);
-     }
-     return arrivalTimes;
+     // For demonstration: lambda(t) = 2 + 2 sin(0.1 * pi * t)
+     // which oscillates between 0 and 4.
+     return 2.0 + 2.0 * std::sin(0.1 * M_PI * t);
  }
  
- // 2) Non-Homogeneous Poisson Process (Thinning method)
- //    lambda(t) is a time-varying rate bounded above by lambdaMax.
- //    We first simulate a homogeneous Poisson with rate = lambdaMax,
- //    then accept each arrival with probability lambda(t)/lambdaMax.
- std::vector<double> simulateNonHomogeneousPoisson(
-     std::function<double(double)> lambda_t, // user-supplied rate function
-     double lambdaMax,
-     double T,
-     std::mt19937 &rng)
+ // Its cumulative intensity, for the inversion method.
+ double exampleCumLambda(double t)
  {
-     // Step 1: simulate homogeneous PP with rate = lambdaMax
-     std::vector<double> candidateArrivals = simulateHomogeneousPoisson(lambdaMax, T, rng);
+     return 2.0 * t + (20.0 / M_PI) * (1.0 - std::cos(0.1 * M_PI * t));
+ }
  
-     // Step 2: thinning
-     std::vector<double> acceptedArrivals;
-     std::uniform_real_distribution<double> U(0.0, 1.0);
+ // Time both homogeneous generators for lambda*T = 1 .. 1e7 and print the
+ // cost per arrival, to locate the crossover between the two methods.
+ void benchmarkHomogeneous()
+ {
+     using clock = std::chrono::steady_clock;
+     Xoshiro256StarStar rng = makeStream(12345, 0);
  
-     for (double arrivalTime : candidateArrivals)
+     std::cout << "lambda*T   exponential ns/arrival   order-stats ns/arrival\n";
+     for (double lambdaT = 1.0; lambdaT <= 1e7; lambdaT *= 10.0)
      {
-         double acceptProb = lambda_t(arrivalTime) / lambdaMax;
-         if (U(rng) < acceptProb)
+         // Repeat so that every point simulates about 2e7 arrivals.
+         long long reps = static_cast<long long>(std::max(1.0, 2e7 / lambdaT));
+         double nsPerArrival[2];
+         for (int m = 0; m < 2; m++)
          {
-             acceptedArrivals.push_back(arrivalTime);
+             PoissonMethod method = m == 0 ? PoissonMethod::Exponential : PoissonMethod::OrderStatistics;
+             long long arrivals = 0;
+             auto t0 = clock::now();
+             for (long long r = 0; r < reps; r++)
+             {
+                 arrivals += static_cast<long long>(simulateHomogeneousPoisson(lambdaT, 1.0, rng, method).size());
+             }
+             double sec = std::chrono::duration<double>(clock::now() - t0).count();
+             nsPerArrival[m] = 1e9 * sec / std::max(1LL, arrivals);
          }
+         std::cout << std::setw(8) << lambdaT << "   " << std::setw(22) << nsPerArrival[0]
+                   << "   " << std::setw(22) << nsPerArrival[1] << "\n";
      }
-     return acceptedArrivals;
  }
  
- // 3) Compound Poisson Process
- //    Y(t) = sum_{i=1 to N(t)} of X_i, where N(t) is a Poisson process, and
- //    X_i are i.i.d. random jumps (independent of N(t)).
- //
- //    This function returns a vector of (time, process-value) pairs to
- //    illustrate how the compound process evolves over time.
- //
- //    - 'jumpGenerator(rng)' is a function/lambda that generates one random jump X_i.
- std::vector<std::pair<double,double>> simulateCompoundPoisson(
-     double lambda,
-     double T,
-     std::mt19937 &rng,
-     std::function<double(std::mt19937 &)> jumpGenerator)
+ // Usage: PoissonProcess [--bench | --trace file [T]]
+ int main(int argc, char *argv[])
  {
-     std::vector<std::pair<double,double>> processPath;
- 
-     // First, get the arrival times from a homogeneous Poisson process
-     std::vector<double> arrivalTimes = simulateHomogeneousPoisson(lambda, T, rng);
- 
-     // We'll keep track of the compound sum so far
-     double compoundValue = 0.0;
- 
-     // For each arrival time, we "jump" by a random amount
-     for (double t : arrivalTimes)
+     if (argc > 1 && std::string(argv[1]) == "--bench")
      {
-         double jumpSize = jumpGenerator(rng);
-         compoundValue += jumpSize;
-         // Store the time and the new value of the process
-         processPath.push_back({t, compoundValue});
+         benchmarkHomogeneous();
+         return 0;
+     }
+     if (argc > 2 && std::string(argv[1]) == "--trace")
+     {
+         // Compound Poisson path with rate 1 and Uniform(0,1) jumps.
+         double T = argc > 3 ? std::atof(argv[3]) : 1e7;
+         writeCompoundPoissonTrace(argv[2], 1.0, T, 12345,
+                                   [](Xoshiro256StarStar &r) { return toUnitDouble(r()); });
+         std::cout << "Wrote compound Poisson path up to T=" << T << " to " << argv[2] << "\n";
+         return 0;
      }
  
-     return processPath;
- }
- 
- // Example rate function for non-homogeneous process
- double exampleLambda(double t)
- {
-     // For demonstration: lambda(t) = 2 + 2 sin(0.1 * pi * t)
-     // which oscillates between 0 and 4.
-     return 2.0 + 2.0 * std::sin(0.1 * M_PI * t);
- }
- 
- int main()
- {
      // Initialize Mersenne Twister RNG with a seed
      std::random_device rd;
      std::mt19937 rng(rd());
@@ -122,15 +99,50 @@
  
      std::cout << "Homogeneous Poisson (lambda=1, T=10) generated "
                << arrivalsHom.size() << " arrivals.\n";
+
+     // Same process on a counter-based stream: reproducible for a fixed
+     // (seed, stream) and independent of every other stream.
+     Philox4x32 philox = makeStreamOf<Philox4x32>(12345, 0);
+     std::vector<double> arrivalsPhilox = simulateHomogeneousPoisson(lambda, T, philox);
+
+     std::cout << "Homogeneous Poisson on Philox stream 0 generated "
+               << arrivalsPhilox.size() << " arrivals.\n";
+ 
+     std::vector<double> arrivalsOrd =
+         simulateHomogeneousPoisson(lambda, T, rng, PoissonMethod::OrderStatistics);
+     std::cout << "Homogeneous Poisson by order statistics generated "
+               << arrivalsOrd.size() << " arrivals.\n";
+ 
+     // A long horizon split into time slices, one RNG stream per slice;
+     // the result for seed 12345 is the same for any number of threads.
+     unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+     std::vector<double> arrivalsPar = simulateHomogeneousPoissonParallel(lambda, 1e7, 12345, nThreads);
+     std::cout << "Time-sliced Poisson (lambda=1, T=1e7, " << nThreads << " threads) generated "
+               << arrivalsPar.size() << " arrivals.\n";
  
      // ============ 2) Non-Homogeneous Poisson Example ==========
      double lambdaMax = 4.0;  // must be >= max of exampleLambda(t) over [0, T]
+     // Passing a lambda (rather than a function pointer or std::function)
+     // lets the compiler inline exampleLambda into the thinning loop.
      std::vector<double> arrivalsNonHom =
-         simulateNonHomogeneousPoisson(exampleLambda, lambdaMax, T, rng);
+         simulateNonHomogeneousPoisson([](double t) { return exampleLambda(t); }, lambdaMax, T, rng);
  
      std::cout << "Non-homogeneous Poisson generated "
                << arrivalsNonHom.size() << " arrivals.\n";
  
+     // Same rate with a 20-segment envelope (|lambda'| <= 0.2*pi makes it
+     // a rigorous bound) and with the exact inversion method.
+     auto rate = [](double t) { return exampleLambda(t); };
+     RateEnvelope env = buildRateEnvelope(rate, T, 20, 16, 0.2 * M_PI);
+     std::vector<double> arrivalsEnv = simulateNonHomogeneousPoisson(rate, env, rng);
+     std::vector<double> arrivalsInv =
+         simulatePoissonByInversion([](double t) { return exampleCumLambda(t); }, rate, T, rng);
+ 
+     double meanArrivals = exampleCumLambda(T);
+     std::cout << "  with envelope: " << arrivalsEnv.size() << " arrivals, expected rejected candidates "
+               << env.integral() - meanArrivals << " (global bound: " << lambdaMax * T - meanArrivals << ")\n";
+     std::cout << "  by inversion:  " << arrivalsInv.size() << " arrivals, no rejections\n";
+ 
      // ============ 3) Compound Poisson Example =================
      // We'll use a uniform jump distribution in [0,1] just as an example.
      std::uniform_real_distribution<double> jumpDist(0.0, 1.0);
@@ -152,6 +164,35 @@
                    << " is " << compoundPath.back().second << "\n";
      }
  
+     // Compact float32 delta-encoded path, and Y(T) / Y on a grid without paths.
+     CompoundPoissonPath<float> compact =
+         simulateCompoundPoissonSoA<float>(1.0, 10.0, rng, jumpGen, PathEncoding::Delta);
+     std::cout << "Compact path: " << compact.size() << " jumps in "
+               << compact.size() * 2 * sizeof(float) << " bytes\n";
+     std::cout << "Y(T) only: " << simulateCompoundPoissonFinal(1.0, 10.0, rng, jumpGen) << "\n";
+     std::vector<double> atGrid = simulateCompoundPoissonAtGrid(1.0, {2.5, 5.0, 7.5, 10.0}, rng, jumpGen);
+     std::cout << "Y at t = 2.5, 5, 7.5, 10:";
+     for (double y : atGrid) std::cout << " " << y;
+     std::cout << "\n";
+ 
+     // Distribution of Y(T) over a million replications, no paths kept.
+     // Uniform(0,1) jumps with rate 1 and T = 10: E[Y] = 5, Var[Y] = 10/3.
+     auto t0 = std::chrono::steady_clock::now();
+     CompoundPoissonBatch batch = simulateCompoundPoissonBatch(
+         1.0, 10.0, 1000000, UniformJumps{0.0, 1.0}, Histogram(0.0, 20.0, 400), 12345, nThreads);
+     double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+     std::cout << "Batch of " << batch.moments.count() << " replications of Y(T): mean "
+               << batch.moments.mean() << " +- " << batch.moments.ciHalfWidth() << ", variance "
+               << batch.moments.variance() << ", median " << batch.histogram.quantile(0.5)
+               << ", 99% quantile " << batch.histogram.quantile(0.99) << " (" << sec << " s)\n";
+     std::cout << "  with N(T) as control variate: mean " << batch.controlled.mean() << " +- "
+               << batch.controlled.ciHalfWidth() << "\n";
+
+     // P(Y(T) > 20) for rate 5, T = 1 and exponential(1) jumps (E[Y] = 5).
+     EstimatorComparison tail = compareCompoundPoissonTail(5.0, 1.0, 1.0, 20.0, 1000000, 12345, nThreads);
+     std::cout << "P(Y(T) > 20), exact " << compoundPoissonExponentialTail(5.0, 1.0, 1.0, 20.0) << ":\n";
+     tail.print(std::cout);
+ 
      return 0;
  }
  
\ No newline at end of file
@@ -0,0 +1,929 @@
+/************************************************************
+ * Poisson process kernels, shared by PoissonProcess.cpp and
+ * the parameter sweep:
+ *  1) homogeneous processes (exponential gaps or order
+ *     statistics, also split over threads)
+ *  2) non-homogeneous processes (thinning, piecewise-constant
+ *     envelopes, inversion of the cumulative rate)
+ *  3) compound processes (paths, grids, SoA batches with
+ *     control variates, variance-reduced tail estimators)
+ *  4) trace files
+ *
+ * Every simulator takes its random engine explicitly.
+ ************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../Common/RandomStreams.hpp"
+#include "../Common/Philox.hpp"
+#include "../Common/Instrumentation.hpp"
+#include "../Common/OnlineStats.hpp"
+#include "../Common/TraceFile.hpp"
+#include "../Common/VarianceReduction.hpp"
+
+ // Room for a Poisson(mean) number of events: the mean plus four standard
+ // deviations, so output vectors reserved with it almost never reallocate.
+ inline std::size_t expectedCapacity(double mean)
+ {
+     return static_cast<std::size_t>(mean + 4.0 * std::sqrt(mean) + 1.0);
+ }
+ 
+ // 1) Homogeneous Poisson Process
+ //    Returns a vector of arrival times that occur before time T.
+ //    'rng' can be any random engine (std::mt19937, Xoshiro256StarStar,
+ //    the counter-based Philox4x32, ...), fixed at compile time.
+ template <class Rng>
+ std::vector<double> simulateHomogeneousPoisson(double lambda, double T, Rng &rng)
+ {
+     std::vector<double> arrivalTimes;
+     // exponential_distribution(rate) means average interarrival time = 1/lambda
+     std::exponential_distribution<double> expDist(lambda);
+ 
+     double t = 0.0;
+     // Generate arrivals until time exceeds T
+     while (true)
+     {
+         double dt = expDist(rng); // next interarrival time
+         t += dt;
+         if (t > T) break;
+         if (arrivalTimes.size() == arrivalTimes.capacity()) STOCHSIM_COUNT(Counter::Allocations, 1);
+         arrivalTimes.push_back(t);
+     }
+     return arrivalTimes;
+ }
+ 
+ //    Fill out[0..n) with n sorted uniforms on [a, b) by the spacings method
+ //    (see 1b below). The buffer is written once with the running sums and
+ //    rescaled in a second, vectorizable pass.
+ template <class Rng>
+ void fillSortedUniforms(double *out, long long n, double a, double b, Rng &rng)
+ {
+     if (n == 0) return;
+ 
+     // Exponential spacings, accumulated in place.
+     std::uniform_real_distribution<double> U(0.0, 1.0);
+     double sum = 0.0;
+     for (long long i = 0; i < n; i++)
+     {
+         sum -= std::log(1.0 - U(rng));
+         out[i] = sum;
+     }
+     const double lastGap = -std::log(1.0 - U(rng));   // E_{N+1}
+ 
+     const double scale = (b - a) / (sum + lastGap);
+     for (long long i = 0; i < n; i++) out[i] = a + out[i] * scale;
+ }
+ 
+ // 1b) Homogeneous Poisson Process via order statistics
+ //    Given N(T) = N, the arrival times are N sorted uniforms on [0, T].
+ //    So: draw N ~ Poisson(lambda*T), allocate exactly N slots, and fill them
+ //    with sorted uniforms built from spacings: with E_1..E_{N+1} unit
+ //    exponentials and S_k = E_1 + ... + E_k, the values S_k / S_{N+1}
+ //    (k = 1..N) are distributed as N sorted uniforms on [0, 1].
+ //    There is no reallocation at all.
+ template <class Rng>
+ std::vector<double> simulateHomogeneousPoissonOrderStats(double lambda, double T, Rng &rng)
+ {
+     std::poisson_distribution<long long> countDist(lambda * T);
+     const long long n = countDist(rng);
+ 
+     std::vector<double> arrivalTimes(static_cast<std::size_t>(n));
+     fillSortedUniforms(arrivalTimes.data(), n, 0.0, T, rng);
+     return arrivalTimes;
+ }
+ 
+ //    Selects one of the two homogeneous generators at run time.
+ enum class PoissonMethod
+ {
+     Exponential,      // sum exponential interarrival times (push_back per arrival)
+     OrderStatistics   // Poisson count + sorted uniforms (one exact allocation)
+ };
+ 
+ template <class Rng>
+ std::vector<double> simulateHomogeneousPoisson(double lambda, double T, Rng &rng, PoissonMethod method)
+ {
+     return method == PoissonMethod::OrderStatistics ? simulateHomogeneousPoissonOrderStats(lambda, T, rng)
+                                                     : simulateHomogeneousPoisson(lambda, T, rng);
+ }
+ 
+ // 1c) Parallel, time-sliced homogeneous Poisson process for huge horizons
+ //    Counts on disjoint intervals are independent, so [0, T] is cut into
+ //    nSlices equal slices and slice k is generated from stream k of 'seed'.
+ //    The number of slices depends only on lambda*T and sliceArrivals (the
+ //    target expected arrivals per slice), never on the number of threads,
+ //    so the output is identical for any nThreads.
+ //
+ //    Two passes: first every slice draws its count, which gives the total
+ //    and each slice's offset; then allocate(total) is called once and the
+ //    slices fill their own ranges of that buffer in parallel (sorted
+ //    uniforms, as in the order-statistics method). 'allocate' returns a
+ //    double* with room for 'total' values; it can point into a vector, a
+ //    huge page or a memory-mapped output file.
+ template <class Engine = Xoshiro256StarStar, class Allocate>
+ long long simulateHomogeneousPoissonParallelInto(double lambda, double T, std::uint64_t seed, unsigned nThreads,
+                                                  Allocate &&allocate, double sliceArrivals = 1048576.0)
+ {
+     if (nThreads == 0) nThreads = 1;
+     const long long nSlices = std::max(1LL, static_cast<long long>(std::ceil(lambda * T / sliceArrivals)));
+     const double width = T / nSlices;
+ 
+     std::vector<Engine> sliceRng = makeStreamsOf<Engine>(seed, 0, static_cast<std::size_t>(nSlices));
+     std::vector<long long> offset(static_cast<std::size_t>(nSlices) + 1, 0);
+ 
+     // Runs body(k) for every slice k, slices handed out through a counter.
+     auto forEachSlice = [&](auto body) {
+         std::atomic<long long> next(0);
+         auto worker = [&]() {
+             for (long long k = next++; k < nSlices; k = next++) body(k);
+         };
+         std::vector<std::thread> workers;
+         for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker);
+         worker();
+         for (auto &w : workers) w.join();
+     };
+ 
+     forEachSlice([&](long long k) {
+         std::poisson_distribution<long long> countDist(lambda * width);
+         offset[k + 1] = countDist(sliceRng[k]);
+     });
+     for (long long k = 0; k < nSlices; k++) offset[k + 1] += offset[k];
+ 
+     const long long total = offset[nSlices];
+     double *out = allocate(total);
+     forEachSlice([&](long long k) {
+         double a = k * width;
+         double b = (k + 1 == nSlices) ? T : (k + 1) * width;
+         fillSortedUniforms(out + offset[k], offset[k + 1] - offset[k], a, b, sliceRng[k]);
+     });
+     return total;
+ }
+ 
+ //    Same, returned as a vector.
+ template <class Engine = Xoshiro256StarStar>
+ std::vector<double> simulateHomogeneousPoissonParallel(double lambda, double T, std::uint64_t seed, unsigned nThreads,
+                                                        double sliceArrivals = 1048576.0)
+ {
+     std::vector<double> arrivalTimes;
+     simulateHomogeneousPoissonParallelInto<Engine>(lambda, T, seed, nThreads, [&](long long total) {
+         arrivalTimes.resize(static_cast<std::size_t>(total));
+         return arrivalTimes.data();
+     }, sliceArrivals);
+     return arrivalTimes;
+ }
+ 
+ // 2) Non-Homogeneous Poisson Process (Thinning method)
+ //    lambda(t) is a time-varying rate bounded above by lambdaMax.
+ //    Candidates of a homogeneous Poisson process with rate = lambdaMax are
+ //    generated one at a time and each is accepted with probability
+ //    lambda(t)/lambdaMax straight away, so no candidate list is built.
+ //    Every accepted arrival time is passed to emit(t), in increasing order.
+ //
+ //    RateFn is any callable double(double) and Rng any engine. Both are
+ //    template parameters, so a lambda rate is inlined into the thinning
+ //    loop instead of going through a type-erased call per candidate.
+ template <class RateFn, class Rng, class Sink>
+ void thinNonHomogeneousPoisson(
+     RateFn &&lambda_t, // user-supplied rate function
+     double lambdaMax,
+     double T,
+     Rng &rng,
+     Sink &&emit)
+ {
+     std::exponential_distribution<double> expDist(lambdaMax);
+     std::uniform_real_distribution<double> U(0.0, 1.0);
+ 
+     double t = 0.0;
+     while (true)
+     {
+         t += expDist(rng); // next candidate
+         if (t > T) break;
+         STOCHSIM_COUNT(Counter::Proposals, 1);
+         if (U(rng) * lambdaMax < lambda_t(t))
+         {
+             emit(t);
+         }
+         else
+         {
+             STOCHSIM_COUNT(Counter::Rejections, 1);
+         }
+     }
+ }
+ 
+ //    Expected number of arrivals on [0, T], i.e. the integral of lambda(t),
+ //    by the trapezoidal rule on nPoints intervals.
+ template <class RateFn>
+ double expectedArrivals(RateFn &&lambda_t, double T, int nPoints = 256)
+ {
+     double h = T / nPoints;
+     double sum = 0.5 * (lambda_t(0.0) + lambda_t(T));
+     for (int i = 1; i < nPoints; i++) sum += lambda_t(i * h);
+     return sum * h;
+ }
+ 
+ //    Same process written into a caller-supplied buffer (cleared first).
+ //    Reusing one buffer across many runs avoids all allocations once it
+ //    has grown to the largest run.
+ template <class RateFn, class Rng>
+ void simulateNonHomogeneousPoisson(
+     RateFn &&lambda_t,
+     double lambdaMax,
+     double T,
+     Rng &rng,
+     std::vector<double> &acceptedArrivals)
+ {
+     acceptedArrivals.clear();
+     thinNonHomogeneousPoisson(lambda_t, lambdaMax, T, rng,
+                               [&](double t) { acceptedArrivals.push_back(t); });
+ }
+ 
+ //    Returns the accepted arrival times. Capacity is reserved up front
+ //    (see expectedCapacity), so the vector normally never reallocates.
+ template <class RateFn, class Rng>
+ std::vector<double> simulateNonHomogeneousPoisson(
+     RateFn &&lambda_t, // user-supplied rate function
+     double lambdaMax,
+     double T,
+     Rng &rng)
+ {
+     double mean = expectedArrivals(lambda_t, T);
+     std::vector<double> acceptedArrivals;
+     acceptedArrivals.reserve(expectedCapacity(mean));
+ 
+     thinNonHomogeneousPoisson(lambda_t, lambdaMax, T, rng,
+                               [&](double t) { acceptedArrivals.push_back(t); });
+     return acceptedArrivals;
+ }
+ 
+ //    Convenience wrapper for a rate held in a std::function.
+ inline std::vector<double> simulateNonHomogeneousPoisson(
+     std::function<double(double)> lambda_t,
+     double lambdaMax,
+     double T,
+     std::mt19937 &rng)
+ {
+     return simulateNonHomogeneousPoisson<std::function<double(double)> &, std::mt19937>(
+         lambda_t, lambdaMax, T, rng);
+ }
+ 
+ // 2b) Thinning with a piecewise-constant envelope
+ //    A single lambdaMax wastes most candidates when the rate is peaky.
+ //    Instead, [0, T] is cut into segments [breaks[i], breaks[i+1]) with
+ //    their own bound levels[i] >= lambda(t); candidates are generated per
+ //    segment at that level, so the fraction of rejected candidates is
+ //    1 - (integral of lambda) / (integral of the envelope).
+ struct RateEnvelope
+ {
+     std::vector<double> breaks; // m + 1 increasing times, breaks[0] = 0, breaks[m] = T
+     std::vector<double> levels; // m upper bounds, one per segment
+ 
+     double horizon() const { return breaks.back(); }
+ 
+     //  Expected number of candidates the envelope generates.
+     double integral() const
+     {
+         double sum = 0.0;
+         for (std::size_t i = 0; i < levels.size(); i++) sum += levels[i] * (breaks[i + 1] - breaks[i]);
+         return sum;
+     }
+ };
+ 
+ //    Build an envelope with nSegments equal segments by sampling lambda at
+ //    samplesPerSegment equally spaced points of each segment (end points
+ //    included) and taking the maximum. Sampling alone can miss a peak
+ //    between two points; pass a Lipschitz constant L of lambda (|lambda'| <= L)
+ //    to add the L * spacing / 2 that makes the bound rigorous. Throws
+ //    std::invalid_argument unless nSegments >= 1 and samplesPerSegment >= 2.
+ template <class RateFn>
+ RateEnvelope buildRateEnvelope(RateFn &&lambda_t, double T, int nSegments,
+                                int samplesPerSegment = 16, double lipschitz = 0.0)
+ {
+     if (nSegments < 1 || samplesPerSegment < 2)
+         throw std::invalid_argument("a rate envelope needs at least one segment and two samples per segment");
+     STOCHSIM_PHASE("poisson.envelope");
+     RateEnvelope env;
+     double width = T / nSegments;
+     double spacing = width / (samplesPerSegment - 1);
+     env.breaks.reserve(nSegments + 1);
+     env.levels.reserve(nSegments);
+ 
+     for (int i = 0; i < nSegments; i++)
+     {
+         double a = i * width;
+         double level = 0.0;
+         for (int k = 0; k < samplesPerSegment; k++)
+         {
+             level = std::max(level, lambda_t(std::min(a + k * spacing, T)));
+         }
+         env.breaks.push_back(a);
+         env.levels.push_back(level + 0.5 * lipschitz * spacing);
+     }
+     env.breaks.push_back(T);
+     return env;
+ }
+ 
+ //    Thinning against the envelope; emit(t) gets the accepted times in order.
+ template <class RateFn, class Rng, class Sink>
+ void thinNonHomogeneousPoisson(RateFn &&lambda_t, const RateEnvelope &env, Rng &rng, Sink &&emit)
+ {
+     std::exponential_distribution<double> unitExp(1.0);
+     std::uniform_real_distribution<double> U(0.0, 1.0);
+ 
+     for (std::size_t i = 0; i < env.levels.size(); i++)
+     {
+         double level = env.levels[i];
+         if (level <= 0.0) continue; // lambda is zero on this segment
+         double end = env.breaks[i + 1];
+         // The exponential is memoryless, so restarting at every break is exact.
+         double t = env.breaks[i];
+         while (true)
+         {
+             t += unitExp(rng) / level;
+             if (t >= end) break;
+             STOCHSIM_COUNT(Counter::Proposals, 1);
+             if (U(rng) * level < lambda_t(t))
+             {
+                 emit(t);
+             }
+             else
+             {
+                 STOCHSIM_COUNT(Counter::Rejections, 1);
+             }
+         }
+     }
+ }
+ 
+ template <class RateFn, class Rng>
+ std::vector<double> simulateNonHomogeneousPoisson(RateFn &&lambda_t, const RateEnvelope &env, Rng &rng)
+ {
+     double mean = expectedArrivals(lambda_t, env.horizon());
+     std::vector<double> acceptedArrivals;
+     acceptedArrivals.reserve(expectedCapacity(mean));
+ 
+     thinNonHomogeneousPoisson(lambda_t, env, rng, [&](double t) { acceptedArrivals.push_back(t); });
+     return acceptedArrivals;
+ }
+ 
+ // 2c) Inverse cumulative intensity (no rejections at all)
+ //    If the cumulative intensity Lambda(t) = integral_0^t lambda(s) ds is
+ //    known, the arrivals are Lambda^{-1}(S_1), Lambda^{-1}(S_2), ... where
+ //    S_k are the arrival times of a unit-rate Poisson process. Lambda^{-1}
+ //    is found by Newton's method with lambda as derivative, safeguarded by
+ //    bisection between the previous arrival and T. Every random draw yields
+ //    an arrival.
+ template <class CumRateFn, class RateFn, class Rng, class Sink>
+ void simulatePoissonByInversion(CumRateFn &&cumLambda, RateFn &&lambda_t, double T, Rng &rng, Sink &&emit)
+ {
+     std::exponential_distribution<double> unitExp(1.0);
+     const double total = cumLambda(T);
+     const double tol = 1e-12 * std::max(1.0, T);
+ 
+     double s = 0.0;  // unit-rate arrival time
+     double lo = 0.0; // previous arrival, Lambda(lo) <= s
+     while (true)
+     {
+         s += unitExp(rng);
+         if (s > total) break;
+ 
+         double hi = T;
+         double t = lo;
+         for (int iter = 0; iter < 100; iter++)
+         {
+             double f = cumLambda(t) - s;
+             if (f < 0.0) lo = t; else hi = t;
+             if (hi - lo <= tol) break;
+ 
+             double rate = lambda_t(t);
+             double next = (rate > 0.0) ? t - f / rate : 0.5 * (lo + hi);
+             t = (next > lo && next < hi) ? next : 0.5 * (lo + hi);
+         }
+         emit(t);
+         lo = t;
+     }
+ }
+ 
+ template <class CumRateFn, class RateFn, class Rng>
+ std::vector<double> simulatePoissonByInversion(CumRateFn &&cumLambda, RateFn &&lambda_t, double T, Rng &rng)
+ {
+     double mean = cumLambda(T);
+     std::vector<double> arrivals;
+     arrivals.reserve(expectedCapacity(mean));
+     simulatePoissonByInversion(cumLambda, lambda_t, T, rng, [&](double t) { arrivals.push_back(t); });
+     return arrivals;
+ }
+ 
+ // 3) Compound Poisson Process
+ //    Y(t) = sum_{i=1 to N(t)} of X_i, where N(t) is a Poisson process, and
+ //    X_i are i.i.d. random jumps (independent of N(t)).
+ //
+ //    This function returns a vector of (time, process-value) pairs to
+ //    illustrate how the compound process evolves over time.
+ //
+ //    - 'jumpGenerator(rng)' is a function/lambda that generates one random jump X_i.
+ //      Like the rate above, it is a template parameter and gets inlined.
+ template <class Rng, class JumpFn>
+ std::vector<std::pair<double,double>> simulateCompoundPoisson(
+     double lambda,
+     double T,
+     Rng &rng,
+     JumpFn &&jumpGenerator)
+ {
+     std::vector<std::pair<double,double>> processPath;
+     processPath.reserve(expectedCapacity(lambda * T));
+ 
+     // We'll keep track of the compound sum so far
+     double compoundValue = 0.0;
+ 
+     // Arrivals are generated on the fly; at each one we "jump" by a random amount
+     std::exponential_distribution<double> expDist(lambda);
+     double t = 0.0;
+     while (true)
+     {
+         t += expDist(rng);
+         if (t > T) break;
+         double jumpSize = jumpGenerator(rng);
+         compoundValue += jumpSize;
+         // Store the time and the new value of the process
+         processPath.push_back({t, compoundValue});
+     }
+ 
+     return processPath;
+ }
+ 
+ //    How a CompoundPoissonPath stores its columns.
+ enum class PathEncoding
+ {
+     Absolute,   // times[i] = T_i,             values[i] = Y(T_i)
+     Delta       // times[i] = T_i - T_{i-1},   values[i] = X_i (the jump)
+ };
+ 
+ //    Structure-of-arrays compound Poisson path: one column of times, one of
+ //    values, so an event costs 2 * sizeof(Real) bytes. With Real = float the
+ //    Delta encoding is the one to use: gaps and jumps keep their relative
+ //    precision, while absolute float times would lose it on long horizons.
+ template <class Real = double>
+ struct CompoundPoissonPath
+ {
+     PathEncoding encoding = PathEncoding::Absolute;
+     std::vector<Real> times;
+     std::vector<Real> values;
+ 
+     std::size_t size() const { return times.size(); }
+ 
+     //  Absolute (time, value) columns in double precision, summing in double.
+     CompoundPoissonPath<double> decode() const
+     {
+         CompoundPoissonPath<double> out;
+         out.times.assign(times.begin(), times.end());
+         out.values.assign(values.begin(), values.end());
+         if (encoding == PathEncoding::Delta)
+         {
+             for (std::size_t i = 1; i < out.size(); i++)
+             {
+                 out.times[i] += out.times[i - 1];
+                 out.values[i] += out.values[i - 1];
+             }
+         }
+         return out;
+     }
+ };
+ 
+ //    Same process as simulateCompoundPoisson, written to a CompoundPoissonPath.
+ template <class Real = double, class Rng, class JumpFn>
+ CompoundPoissonPath<Real> simulateCompoundPoissonSoA(
+     double lambda,
+     double T,
+     Rng &rng,
+     JumpFn &&jumpGenerator,
+     PathEncoding encoding = PathEncoding::Absolute)
+ {
+     CompoundPoissonPath<Real> path;
+     path.encoding = encoding;
+     path.times.reserve(expectedCapacity(lambda * T));
+     path.values.reserve(expectedCapacity(lambda * T));
+ 
+     std::exponential_distribution<double> expDist(lambda);
+     double t = 0.0, compoundValue = 0.0;
+     bool delta = (encoding == PathEncoding::Delta);
+     while (true)
+     {
+         double dt = expDist(rng);
+         t += dt;
+         if (t > T) break;
+         double jumpSize = jumpGenerator(rng);
+         compoundValue += jumpSize;
+         path.times.push_back(static_cast<Real>(delta ? dt : t));
+         path.values.push_back(static_cast<Real>(delta ? jumpSize : compoundValue));
+     }
+     return path;
+ }
+ 
+ //    Y(T) only. Given N(T) = n the jump times do not matter, so this draws
+ //    n ~ Poisson(lambda*T) and sums n jumps: no times, no storage.
+ template <class Rng, class JumpFn>
+ double simulateCompoundPoissonFinal(double lambda, double T, Rng &rng, JumpFn &&jumpGenerator)
+ {
+     std::poisson_distribution<long long> countDist(lambda * T);
+     long long n = countDist(rng);
+     double compoundValue = 0.0;
+     for (long long i = 0; i < n; i++) compoundValue += jumpGenerator(rng);
+     return compoundValue;
+ }
+ 
+ //    Y at the ascending checkpoints grid[0] < grid[1] < ...; the increment
+ //    over each gap is an independent compound Poisson sum with a Poisson
+ //    count, again without generating the individual jump times.
+ template <class Rng, class JumpFn>
+ std::vector<double> simulateCompoundPoissonAtGrid(double lambda, const std::vector<double> &grid,
+                                                   Rng &rng, JumpFn &&jumpGenerator)
+ {
+     std::vector<double> values;
+     values.reserve(grid.size());
+     double previous = 0.0, compoundValue = 0.0;
+     for (double t : grid)
+     {
+         compoundValue += simulateCompoundPoissonFinal(lambda, t - previous, rng, jumpGenerator);
+         values.push_back(compoundValue);
+         previous = t;
+     }
+     return values;
+ }
+ 
+ // 3b) Batched compound Poisson: the distribution of Y(T) over many replications
+ //    Only Y(T) of each replication is needed, so nothing per path is kept:
+ //    every value goes straight into a RunningStats (moments) and a
+ //    Histogram (distribution / quantiles), and the values themselves are
+ //    discarded.
+ //
+ //    Jumps are drawn in blocks. A block jump distribution has
+ //    fill(rng, out, n), writing n i.i.d. jumps; the ones below first draw n
+ //    raw words (stored in 'out' with memcpy, so no aliasing rules are
+ //    broken) and then transform them in a separate loop without
+ //    branches, which the compiler vectorizes (the log in ExponentialJumps
+ //    needs a vector math library, e.g. glibc with -O3 -ffast-math).
+ struct UniformJumps
+ {
+     double a, b;
+ 
+     template <class Rng64>
+     void fill(Rng64 &rng, double *out, std::size_t n) const
+     {
+         static_assert(Rng64::min() == 0 && Rng64::max() == UINT64_MAX, "engine must produce 64-bit words");
+         for (std::size_t i = 0; i < n; i++)
+         {
+             const std::uint64_t word = rng();
+             std::memcpy(out + i, &word, sizeof word);
+         }
+         for (std::size_t i = 0; i < n; i++)
+         {
+             std::uint64_t word;
+             std::memcpy(&word, out + i, sizeof word);
+             out[i] = a + (b - a) * toUnitDouble52(word);
+         }
+     }
+ };
+ 
+ struct ExponentialJumps
+ {
+     double mean;
+ 
+     template <class Rng64>
+     void fill(Rng64 &rng, double *out, std::size_t n) const
+     {
+         static_assert(Rng64::min() == 0 && Rng64::max() == UINT64_MAX, "engine must produce 64-bit words");
+         for (std::size_t i = 0; i < n; i++)
+         {
+             const std::uint64_t word = rng();
+             std::memcpy(out + i, &word, sizeof word);
+         }
+         for (std::size_t i = 0; i < n; i++)
+         {
+             std::uint64_t word;
+             std::memcpy(&word, out + i, sizeof word);
+             out[i] = -mean * std::log(1.0 - toUnitDouble52(word));
+         }
+     }
+ };
+ 
+ //    Any scalar jump generator jump(rng), as used by simulateCompoundPoisson,
+ //    turned into a block distribution (one call per jump).
+ template <class JumpFn>
+ struct ScalarJumps
+ {
+     JumpFn jump;
+ 
+     template <class Rng>
+     void fill(Rng &rng, double *out, std::size_t n) const
+     {
+         for (std::size_t i = 0; i < n; i++) out[i] = jump(rng);
+     }
+ };
+ 
+ template <class JumpFn>
+ ScalarJumps<JumpFn> scalarJumps(JumpFn jump)
+ {
+     return ScalarJumps<JumpFn>{jump};
+ }
+ 
+ //    Moments and histogram of Y(T) over a batch of replications. 'controlled'
+ //    estimates E[Y(T)] with the jump count N(T) as control variate (known
+ //    mean lambda T), which removes the part of Var Y(T) caused by the
+ //    number of jumps.
+ struct CompoundPoissonBatch
+ {
+     RunningStats moments;
+     Histogram histogram;
+     ControlVariateStats controlled;
+
+     void merge(const CompoundPoissonBatch &other)
+     {
+         moments.merge(other.moments);
+         histogram.merge(other.histogram);
+         controlled.merge(other.controlled);
+     }
+
+     template <class Archive>
+     void serialize(Archive &ar, const unsigned int)
+     {
+         ar &moments &histogram &controlled;
+     }
+ };
+
+ //    One block of 'reps' replications on 'rng', added to 'out'. 'counts'
+ //    and 'buffer' are scratch space of at least reps and jumpChunk values.
+ //    The Poisson counts are drawn first, then the jumps are generated into
+ //    'buffer' and summed replication by replication.
+ template <class Engine, class BlockJumps>
+ void simulateCompoundPoissonBlock(double lambda, double T, long long reps, const BlockJumps &jumps, Engine &rng,
+                                   std::vector<long long> &counts, std::vector<double> &buffer,
+                                   RunningStats &moments, ControlVariateStats &controlled, Histogram &hist)
+ {
+     const std::size_t jumpChunk = buffer.size();
+     std::poisson_distribution<long long> countDist(lambda * T);
+     for (long long r = 0; r < reps; r++) counts[r] = countDist(rng);
+
+     std::size_t used = jumpChunk;   // jumps of 'buffer' already consumed
+     for (long long r = 0; r < reps; r++)
+     {
+         double compoundValue = 0.0;
+         long long left = counts[r];
+         while (left > 0)
+         {
+             if (used == jumpChunk)
+             {
+                 jumps.fill(rng, buffer.data(), jumpChunk);
+                 used = 0;
+             }
+             std::size_t take = static_cast<std::size_t>(
+                 std::min<long long>(left, static_cast<long long>(jumpChunk - used)));
+             for (std::size_t i = 0; i < take; i++) compoundValue += buffer[used + i];
+             used += take;
+             left -= static_cast<long long>(take);
+         }
+         moments.add(compoundValue);
+         controlled.add(compoundValue, static_cast<double>(counts[r]));
+         hist.add(compoundValue);
+     }
+ }
+ 
+ //    Replications are grouped into blocks of batchBlock; block b uses
+ //    stream b of 'seed' and keeps its own moments, which are merged in
+ //    block order at the end. Blocks are handed to the threads through a
+ //    counter, so the result is the same for any nThreads. Each block runs
+ //    simulateCompoundPoissonBlock with a buffer of jumpChunk values.
+ //    'histogram' gives the bin layout; Y(T) values are added to whatever it
+ //    already holds.
+ template <class Engine = Xoshiro256StarStar, class BlockJumps>
+ CompoundPoissonBatch simulateCompoundPoissonBatch(double lambda, double T, long long replications,
+                                                   const BlockJumps &jumps, Histogram histogram,
+                                                   std::uint64_t seed, unsigned nThreads,
+                                                   long long batchBlock = 4096, std::size_t jumpChunk = 4096)
+ {
+     if (nThreads == 0) nThreads = 1;
+     const long long nBlocks = (replications + batchBlock - 1) / batchBlock;
+     std::vector<RunningStats> blockMoments(static_cast<std::size_t>(nBlocks));
+     std::vector<ControlVariateStats> blockControlled(static_cast<std::size_t>(nBlocks),
+                                                      ControlVariateStats(lambda * T));
+     std::vector<Engine> blockRng = makeStreamsOf<Engine>(seed, 0, static_cast<std::size_t>(nBlocks));
+     Histogram emptyHistogram = histogram;
+     emptyHistogram.clear();
+     std::vector<Histogram> threadHistograms(nThreads, emptyHistogram);
+ 
+     std::atomic<long long> next(0);
+     auto worker = [&](unsigned w) {
+         std::vector<long long> counts(static_cast<std::size_t>(batchBlock));
+         std::vector<double> buffer(jumpChunk);
+ 
+         for (long long b = next++; b < nBlocks; b = next++)
+         {
+             long long reps = std::min(batchBlock, replications - b * batchBlock);
+             simulateCompoundPoissonBlock(lambda, T, reps, jumps, blockRng[b], counts, buffer, blockMoments[b],
+                                          blockControlled[b], threadHistograms[w]);
+         }
+     };
+     std::vector<std::thread> workers;
+     for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker, w);
+     worker(0);
+     for (auto &w : workers) w.join();
+ 
+     CompoundPoissonBatch result{RunningStats(), histogram, ControlVariateStats(lambda * T)};
+     for (const RunningStats &m : blockMoments) result.moments.merge(m);
+     for (const ControlVariateStats &c : blockControlled) result.controlled.merge(c);
+     for (const Histogram &h : threadHistograms) result.histogram.merge(h);
+     return result;
+ }
+ 
+ // 3c) Variance reduction for a tail probability
+ //    p = P(Y(T) > x) for exponential jumps with mean m, estimated from n
+ //    replications in blocks of TAIL_BLOCK (block b on stream b of 'seed')
+ //    by every estimator of VarianceReduction.hpp:
+ //     - crude: the indicator of Y(T) > x
+ //     - antithetic: gaps and jumps are drawn by inversion, so the mirrored
+ //       run has fewer, smaller jumps when the first has many large ones
+ //     - control variate: the jump count N(T), mean lambda T
+ //     - stratified on N(T) = 0, 1, ..., K - 1 and N(T) >= K, with the
+ //       Poisson probabilities as weights
+ //     - importance sampling by exponential tilting: under the tilt theta
+ //       the rate becomes lambda / (1 - theta m) and the jump mean
+ //       m / (1 - theta m), chosen so that E[Y(T)] = x, and every sample is
+ //       weighted by exp(-theta Y(T) + lambda T (1 / (1 - theta m) - 1))
+ constexpr long long TAIL_BLOCK = 1 << 16;
+
+ //    Y(T) and N(T) from exponential gaps (rate lambda) and jumps (mean m).
+ template <class Rng>
+ std::pair<double, long long> compoundPoissonExponential(double lambda, double T, double m, Rng &rng)
+ {
+     std::exponential_distribution<double> gap(lambda), jump(1.0 / m);
+     double y = 0.0;
+     long long n = 0;
+     for (double t = gap(rng); t <= T; t += gap(rng))
+     {
+         y += jump(rng);
+         n++;
+     }
+     return {y, n};
+ }
+
+ //    Exact p, from P(Gamma(k, m) > x) = P(Poisson(x / m) <= k - 1).
+ inline double compoundPoissonExponentialTail(double lambda, double T, double m, double x)
+ {
+     const double mean = lambda * T;
+     double pk = std::exp(-mean);     // P(N = k)
+     double below = 0.0;              // P(Poisson(x / m) <= k - 1)
+     double qk = std::exp(-x / m);    // P(Poisson(x / m) = k)
+     double p = 0.0;
+     for (long long k = 1; k < 10000 && (k < mean || pk > 1e-300); k++)
+     {
+         pk *= mean / k;
+         below += qk;
+         qk *= x / m / k;
+         p += pk * below;
+     }
+     return p;
+ }
+
+ template <class Engine = Xoshiro256StarStar>
+ EstimatorComparison compareCompoundPoissonTail(double lambda, double T, double m, double x, long long n,
+                                                std::uint64_t seed, unsigned nThreads)
+ {
+     const long long nBlocks = (n + TAIL_BLOCK - 1) / TAIL_BLOCK;
+     auto blockSize = [&](long long b) { return std::min(TAIL_BLOCK, n - b * TAIL_BLOCK); };
+     auto hit = [&](auto &rng) { return compoundPoissonExponential(lambda, T, m, rng).first > x ? 1.0 : 0.0; };
+     EstimatorComparison comparison;
+
+     comparison.run("crude", [&]() {
+         return runInBlocks<Engine>(RunningStats(), nBlocks, seed, nThreads,
+                                    [&](long long b, Engine &rng, RunningStats &s) {
+                                        s.merge(crudeEstimate(hit, blockSize(b), rng));
+                                    });
+     });
+     comparison.run("antithetic", [&]() {
+         return runInBlocks<Engine>(RunningStats(), nBlocks, seed, nThreads,
+                                    [&](long long b, Engine &rng, RunningStats &s) {
+                                        s.merge(antitheticEstimate(hit, blockSize(b) / 2, rng));
+                                    });
+     }, 2);
+     comparison.run("control", [&]() {
+         return runInBlocks<Engine>(ControlVariateStats(lambda * T), nBlocks, seed, nThreads,
+                                    [&](long long b, Engine &rng, ControlVariateStats &s) {
+                                        s.merge(controlVariateEstimate(
+                                            [&](Engine &r) {
+                                                auto yn = compoundPoissonExponential(lambda, T, m, r);
+                                                return std::make_pair(yn.first > x ? 1.0 : 0.0,
+                                                                      static_cast<double>(yn.second));
+                                            },
+                                            lambda * T, blockSize(b), rng));
+                                    });
+     });
+
+     // Strata N = k for k < K and N >= K; the last one is drawn by inversion
+     // of the Poisson distribution conditioned on N >= K.
+     const double mean = lambda * T;
+     const long long K = static_cast<long long>(std::ceil(mean + 4.0 * std::sqrt(mean)));
+     std::vector<double> weights(static_cast<std::size_t>(K + 1));
+     double pk = std::exp(-mean), below = 0.0;
+     for (long long k = 0; k < K; k++)
+     {
+         weights[k] = pk;
+         below += pk;
+         pk *= mean / (k + 1);
+     }
+     weights[K] = 1.0 - below;
+     comparison.run("stratified", [&]() {
+         return runInBlocks<Engine>(StratifiedStats(weights), nBlocks, seed, nThreads,
+                                    [&](long long b, Engine &rng, StratifiedStats &s) {
+             s.merge(stratifiedEstimate(
+                 [&](std::size_t stratum, Engine &r) {
+                     long long count = static_cast<long long>(stratum);
+                     if (count == K)
+                     {
+                         double u = toUnitDouble(r()) * weights[K];
+                         double p = std::exp(-mean);
+                         for (long long k = 1; k <= K; k++) p *= mean / k;
+                         while (u > p && p > 0)
+                         {
+                             u -= p;
+                             count++;
+                             p *= mean / count;
+                         }
+                     }
+                     std::exponential_distribution<double> jump(1.0 / m);
+                     double y = 0.0;
+                     for (long long i = 0; i < count; i++) y += jump(r);
+                     return y > x ? 1.0 : 0.0;
+                 },
+                 weights, blockSize(b), rng));
+         });
+     });
+
+     const double theta = (1.0 - std::sqrt(lambda * T * m / x)) / m;
+     const double tilt = 1.0 / (1.0 - theta * m);
+     comparison.run("importance", [&]() {
+         return runInBlocks<Engine>(RunningStats(), nBlocks, seed, nThreads,
+                                    [&](long long b, Engine &rng, RunningStats &s) {
+             s.merge(importanceEstimate(
+                 [&](Engine &r) { return compoundPoissonExponential(lambda * tilt, T, m * tilt, r).first; },
+                 [&](double y) { return y > x ? 1.0 : 0.0; },
+                 [&](double y) { return std::exp(-theta * y + lambda * T * (tilt - 1.0)); }, blockSize(b), rng));
+         });
+     });
+     return comparison;
+ }
+
+ //    Convenience wrapper for a jump generator held in a std::function.
+ inline std::vector<std::pair<double,double>> simulateCompoundPoisson(
+     double lambda,
+     double T,
+     std::mt19937 &rng,
+     std::function<double(std::mt19937 &)> jumpGenerator)
+ {
+     return simulateCompoundPoisson<std::mt19937, std::function<double(std::mt19937 &)> &>(
+         lambda, T, rng, jumpGenerator);
+ }
+ 
+ // 4) Trace files
+ //    Arrival times of a homogeneous process on stream 0 of 'seed', streamed
+ //    into a trace file without keeping them in memory. Stored as float32
+ //    gaps (delta encoding, 4 bytes per arrival); the reader sums them up
+ //    again in double precision.
+ template <class Engine = Xoshiro256StarStar>
+ void writeHomogeneousPoissonTrace(const std::string &path, double lambda, double T, std::uint64_t seed)
+ {
+     TraceWriter trace(path, seed, {{"time", TraceType::Float32, TraceEncoding::Delta}},
+                       formatTraceParams({{"lambda", lambda}, {"T", T}}));
+     Engine rng = makeStreamOf<Engine>(seed, 0);
+     std::exponential_distribution<double> expDist(lambda);
+     for (double t = expDist(rng); t <= T; t += expDist(rng)) trace.appendRow(t);
+ }
+ 
+ //    (time, value) of a compound Poisson path, both columns as float32
+ //    deltas, i.e. the gaps and the jumps.
+ template <class Engine = Xoshiro256StarStar, class JumpFn>
+ void writeCompoundPoissonTrace(const std::string &path, double lambda, double T, std::uint64_t seed,
+                                JumpFn &&jumpGenerator)
+ {
+     TraceWriter trace(path, seed,
+                       {{"time", TraceType::Float32, TraceEncoding::Delta},
+                        {"value", TraceType::Float32, TraceEncoding::Delta}},
+                       formatTraceParams({{"lambda", lambda}, {"T", T}}));
+     Engine rng = makeStreamOf<Engine>(seed, 0);
+     std::exponential_distribution<double> expDist(lambda);
+     double compoundValue = 0.0;
+     for (double t = expDist(rng); t <= T; t += expDist(rng))
+     {
+         compoundValue += jumpGenerator(rng);
+         trace.appendRow(t, compoundValue);
+     }
+ }
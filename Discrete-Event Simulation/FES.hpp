@@ -0,0 +1,487 @@
+/************************************************************
+ * Event-driven processor-sharing queue of FES.py: Event, the
+ * 4-ary heap FES, the customer pool, SimResults and both
+ * departure bookkeepings (rescaling and the virtual clock).
+ * Shared by FES.cpp and the kernel benchmarks.
+ ************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "../Common/RandomStreams.hpp"
+#include "../Common/Instrumentation.hpp"
+#include "../Common/OnlineStats.hpp"
+
+struct Event
+{
+    static constexpr int ARRIVAL = 0;
+    static constexpr int DEPARTURE = 1;
+
+    double time;
+    int type;
+    int customer;   // index into the CustomerPool
+};
+
+// Future Event Set implemented with a 4-ary min-heap on the event time.
+class FES
+{
+public:
+    void add(const Event &event)
+    {
+        STOCHSIM_COUNT(Counter::QueuePushes, 1);
+        if (heap.size() == heap.capacity()) STOCHSIM_COUNT(Counter::Allocations, 1);
+        heap.push_back(event);
+        siftUp(heap.size() - 1);
+    }
+
+    // Pop the event with the smallest event time; false if the set is empty.
+    bool next(Event &event)
+    {
+        if (heap.empty()) return false;
+        STOCHSIM_COUNT(Counter::QueuePops, 1);
+        event = heap.front();
+        heap.front() = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) siftDown(0);
+        return true;
+    }
+
+    // The earliest event (without removing it); the set must not be empty.
+    const Event &peek() const { return heap.front(); }
+
+    std::size_t size() const { return heap.size(); }
+    bool empty() const { return heap.empty(); }
+
+    // For processor-sharing: when the queue length changes from oldQL to
+    // newQL, the remaining time of every future departure is scaled by
+    // newQL / oldQL. Same rule as FES.updateEventTimes in FES.py, but the
+    // times are rescaled in place and the heap is rebuilt bottom-up in O(n)
+    // instead of popping and re-pushing every event.
+    void updateEventTimes(double currentTime, int oldQL, int newQL)
+    {
+        if (oldQL <= 0 || newQL <= 0 || oldQL == newQL) return;
+        STOCHSIM_COUNT(Counter::QueueRebuilds, 1);
+
+        const double scaleFactor = static_cast<double>(newQL) / static_cast<double>(oldQL);
+        for (Event &evt : heap)
+        {
+            // Arrival times do not depend on the queue length.
+            if (evt.type != Event::DEPARTURE) continue;
+            double remaining = std::max(0.0, evt.time - currentTime);
+            evt.time = currentTime + scaleFactor * remaining;
+        }
+        if (heap.size() < 2) return;
+        for (std::size_t i = (heap.size() - 2) / ARITY + 1; i-- > 0;) siftDown(i);
+    }
+
+private:
+    static constexpr std::size_t ARITY = 4;
+
+    void siftUp(std::size_t i)
+    {
+        const Event moving = heap[i];
+        while (i > 0)
+        {
+            std::size_t parent = (i - 1) / ARITY;
+            if (!(moving.time < heap[parent].time)) break;
+            heap[i] = heap[parent];
+            i = parent;
+        }
+        heap[i] = moving;
+    }
+
+    void siftDown(std::size_t i)
+    {
+        const Event moving = heap[i];
+        const std::size_t n = heap.size();
+        while (true)
+        {
+            std::size_t first = ARITY * i + 1;
+            if (first >= n) break;
+            std::size_t last = std::min(first + ARITY, n);
+            std::size_t best = first;
+            for (std::size_t c = first + 1; c < last; c++)
+            {
+                if (heap[c].time < heap[best].time) best = c;
+            }
+            if (!(heap[best].time < moving.time)) break;
+            heap[i] = heap[best];
+            i = best;
+        }
+        heap[i] = moving;
+    }
+
+    std::vector<Event> heap;
+};
+
+// Simple record of the arrival time and anything else needed.
+struct Customer
+{
+    double arrivalTime;
+};
+
+// Customers referred to by index; released slots go on a free list and are
+// handed out again by the next allocate().
+class CustomerPool
+{
+public:
+    int allocate(double arrivalTime)
+    {
+        if (freeSlots.empty())
+        {
+            if (customers.size() == customers.capacity()) STOCHSIM_COUNT(Counter::Allocations, 1);
+            customers.push_back({arrivalTime});
+            return static_cast<int>(customers.size() - 1);
+        }
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        customers[slot] = {arrivalTime};
+        return slot;
+    }
+
+    void release(int slot) { freeSlots.push_back(slot); }
+
+    Customer &operator[](int slot) { return customers[slot]; }
+
+private:
+    std::vector<Customer> customers;
+    std::vector<int> freeSlots;
+};
+
+// Tracks queue length over time and sojourn times (waiting + service) in
+// streaming accumulators: the time-weighted queue length, the mean and
+// variance of the sojourn times and a t-digest of their distribution, so
+// memory stays constant however long the run. keepHistory also stores every
+// (time, queue length) pair and every sojourn time, like SimResults in
+// FES.py. Results of independent runs combine with merge().
+class SimResults
+{
+public:
+    explicit SimResults(bool keepHistory = false) : keepHistory(keepHistory) {}
+
+    // Accumulate the area under Q(t) since the previous registration.
+    void registerQueueLength(double now, int ql)
+    {
+        queueLength.observe(now, ql);
+        if (keepHistory) queueLengthsHistory.push_back({now, ql});
+    }
+
+    // Record a completed customer's sojourn time.
+    void registerSojournTime(double soj)
+    {
+        sojourn.add(soj);
+        sojournDistribution.add(soj);
+        if (keepHistory) sojournTimes.push_back(soj);
+    }
+
+    // Pool another run: time averages over the total simulated time,
+    // sojourn statistics over all departures. Histories are concatenated.
+    void merge(const SimResults &other)
+    {
+        queueLength.merge(other.queueLength);
+        sojourn.merge(other.sojourn);
+        sojournDistribution.merge(other.sojournDistribution);
+        queueLengthsHistory.insert(queueLengthsHistory.end(), other.queueLengthsHistory.begin(),
+                                   other.queueLengthsHistory.end());
+        sojournTimes.insert(sojournTimes.end(), other.sojournTimes.begin(), other.sojournTimes.end());
+    }
+
+    // Time-average queue length over [0, time of the last registration].
+    double getMeanQueueLength() const { return queueLength.mean(); }
+    double getQueueLengthVariance() const { return queueLength.variance(); }
+
+    double getMeanSojournTime() const { return sojourn.mean(); }
+    double getSojournTimeQuantile(double q) const { return sojournDistribution.quantile(q); }
+    const RunningStats &sojournStats() const { return sojourn; }
+
+    long long events() const { return queueLength.count(); }
+    long long departures() const { return sojourn.count(); }
+
+    std::vector<std::pair<double, int>> queueLengthsHistory;   // only with keepHistory
+    std::vector<double> sojournTimes;                          // only with keepHistory
+
+private:
+    bool keepHistory;
+    TimeWeightedStats queueLength;
+    RunningStats sojourn;
+    TDigest sojournDistribution;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const SimResults &res)
+{
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(4) << "Avg Queue Length = " << res.getMeanQueueLength()
+         << ", Avg Sojourn Time = " << res.getMeanSojournTime();
+    return out << text.str();
+}
+
+// Processor-sharing server driven by a virtual clock, so that no departure
+// ever has to be rescheduled. With n customers in service every one of them
+// receives service at rate 1/n, so the virtual time V(t), with dV/dt = 1/n,
+// is the service attained by any customer present during [s, t] as
+// V(t) - V(s). A customer entering at virtual time V with work X therefore
+// leaves when V reaches its finish tag V + X. Tags never change, so the next
+// departure is the smallest tag, kept in a 4-ary heap: O(log n) per arrival
+// or departure instead of rescaling all n departure events. Each customer
+// gets a handle, which gives its heap position in O(1), so any customer (not
+// only the next to leave) can be removed, e.g. for abandonments.
+class ProcessorSharingServer
+{
+public:
+    using Handle = int;
+
+    // Bring the virtual clock forward to real time 'now'.
+    void advance(double now)
+    {
+        if (!heap.empty()) virtualTime += (now - lastTime) / static_cast<double>(heap.size());
+        lastTime = now;
+    }
+
+    // Start serving 'customer', who needs 'work' units of service, at the
+    // current time (call advance first).
+    Handle add(double work, int customer)
+    {
+        Handle h;
+        if (freeHandles.empty())
+        {
+            h = static_cast<Handle>(position.size());
+            position.push_back(0);
+            customerOf.push_back(0);
+        }
+        else
+        {
+            h = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        customerOf[h] = customer;
+        STOCHSIM_COUNT(Counter::QueuePushes, 1);
+        if (heap.size() == heap.capacity()) STOCHSIM_COUNT(Counter::Allocations, 1);
+        heap.push_back({virtualTime + work, h});
+        position[h] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+        return h;
+    }
+
+    int size() const { return static_cast<int>(heap.size()); }
+    bool empty() const { return heap.empty(); }
+
+    // Real time of the next departure if nobody arrives before it.
+    double nextDepartureTime() const
+    {
+        if (heap.empty()) return std::numeric_limits<double>::infinity();
+        return lastTime + (heap.front().tag - virtualTime) * static_cast<double>(heap.size());
+    }
+
+    // Remove the customer with the smallest finish tag and return it.
+    int popDeparture()
+    {
+        Handle h = heap.front().handle;
+        remove(h);
+        return customerOf[h];
+    }
+
+    // Remove any customer in service through its handle.
+    void remove(Handle h)
+    {
+        STOCHSIM_COUNT(Counter::QueuePops, 1);
+        std::size_t i = position[h];
+        heap[i] = heap.back();
+        position[heap[i].handle] = i;
+        heap.pop_back();
+        if (i < heap.size())
+        {
+            Handle moved = heap[i].handle;
+            siftUp(i);
+            siftDown(position[moved]);
+        }
+        freeHandles.push_back(h);
+    }
+
+    // Service still needed by the customer behind handle h.
+    double remainingWork(Handle h) const { return heap[position[h]].tag - virtualTime; }
+
+private:
+    static constexpr std::size_t ARITY = 4;
+
+    struct Entry
+    {
+        double tag;   // virtual finish time
+        Handle handle;
+    };
+
+    void place(std::size_t i, const Entry &entry)
+    {
+        heap[i] = entry;
+        position[entry.handle] = i;
+    }
+
+    void siftUp(std::size_t i)
+    {
+        const Entry moving = heap[i];
+        while (i > 0)
+        {
+            std::size_t parent = (i - 1) / ARITY;
+            if (!(moving.tag < heap[parent].tag)) break;
+            place(i, heap[parent]);
+            i = parent;
+        }
+        place(i, moving);
+    }
+
+    void siftDown(std::size_t i)
+    {
+        const Entry moving = heap[i];
+        const std::size_t n = heap.size();
+        while (true)
+        {
+            std::size_t first = ARITY * i + 1;
+            if (first >= n) break;
+            std::size_t last = std::min(first + ARITY, n);
+            std::size_t best = first;
+            for (std::size_t c = first + 1; c < last; c++)
+            {
+                if (heap[c].tag < heap[best].tag) best = c;
+            }
+            if (!(heap[best].tag < moving.tag)) break;
+            place(i, heap[best]);
+            i = best;
+        }
+        place(i, moving);
+    }
+
+    std::vector<Entry> heap;
+    std::vector<std::size_t> position;   // heap index of each live handle
+    std::vector<int> customerOf;         // customer behind each handle
+    std::vector<Handle> freeHandles;
+    double virtualTime = 0.0;
+    double lastTime = 0.0;
+};
+
+// How ProcessorSharingSimulation keeps track of the departures.
+enum class PSMode
+{
+    Rescale,       // departure events in the FES, rescaled on every change (as FES.py)
+    VirtualTime    // ProcessorSharingServer: O(log n) per event
+};
+
+// Single-server processor-sharing queue. ArrDist and ServDist are callables
+// double(Rng &) giving the inter-arrival times and the base service times.
+template <class ArrDist, class ServDist>
+class ProcessorSharingSimulation
+{
+public:
+    ProcessorSharingSimulation(ArrDist arrDist, ServDist servDist) : arrDist(arrDist), servDist(servDist) {}
+
+    template <class Rng>
+    SimResults simulate(double T, Rng &rng, bool keepHistory = false, PSMode mode = PSMode::Rescale)
+    {
+        STOCHSIM_PHASE(mode == PSMode::Rescale ? "des.rescale" : "des.virtual_time");
+        if (mode == PSMode::VirtualTime) return simulateVirtualTime(T, rng, keepHistory);
+
+        FES fes;                       // Future Event Set
+        SimResults res(keepHistory);   // Collect results
+        CustomerPool customers;
+        int queueLength = 0;           // customers in service
+        double t = 0.0;                // current simulation time
+
+        // 1) Schedule first arrival
+        double firstArrival = arrDist(rng);
+        fes.add({firstArrival, Event::ARRIVAL, customers.allocate(firstArrival)});
+
+        // 2) Main loop
+        Event e;
+        while (t < T && fes.next(e))
+        {
+            t = e.time;   // jump clock to event time
+            int oldQL = queueLength;
+            res.registerQueueLength(t, oldQL);
+
+            if (e.type == Event::ARRIVAL)
+            {
+                queueLength++;
+                // The others slow down: oldQL -> oldQL + 1 customers share the server.
+                fes.updateEventTimes(t, oldQL, oldQL + 1);
+
+                // With base service X the customer needs X * (oldQL + 1) at the current rate.
+                double departureTime = t + servDist(rng) * (oldQL + 1);
+                fes.add({departureTime, Event::DEPARTURE, e.customer});
+
+                // Also schedule the next arrival
+                double nextArrival = t + arrDist(rng);
+                fes.add({nextArrival, Event::ARRIVAL, customers.allocate(nextArrival)});
+            }
+            else
+            {
+                res.registerSojournTime(t - customers[e.customer].arrivalTime);
+                customers.release(e.customer);
+                queueLength--;
+                // Fewer customers remain, so the others speed up.
+                fes.updateEventTimes(t, oldQL, oldQL - 1);
+            }
+        }
+        return res;
+    }
+
+private:
+    // Same model and the same random draws in the same order as the
+    // rescaling loop, so results agree up to rounding. The FES only holds
+    // arrivals; the next departure comes from the server.
+    template <class Rng>
+    SimResults simulateVirtualTime(double T, Rng &rng, bool keepHistory)
+    {
+        FES fes;
+        SimResults res(keepHistory);
+        CustomerPool customers;
+        ProcessorSharingServer server;
+        double t = 0.0;
+
+        double firstArrival = arrDist(rng);
+        fes.add({firstArrival, Event::ARRIVAL, customers.allocate(firstArrival)});
+
+        Event e;
+        while (t < T)
+        {
+            bool departure = !server.empty() && (fes.empty() || server.nextDepartureTime() <= fes.peek().time);
+            if (!departure && fes.empty()) break;
+            int oldQL = server.size();
+
+            if (departure)
+            {
+                t = server.nextDepartureTime();
+                res.registerQueueLength(t, oldQL);
+                server.advance(t);
+                int c = server.popDeparture();
+                res.registerSojournTime(t - customers[c].arrivalTime);
+                customers.release(c);
+            }
+            else
+            {
+                fes.next(e);
+                t = e.time;
+                res.registerQueueLength(t, oldQL);
+                server.advance(t);
+                server.add(servDist(rng), e.customer);
+
+                double nextArrival = t + arrDist(rng);
+                fes.add({nextArrival, Event::ARRIVAL, customers.allocate(nextArrival)});
+            }
+        }
+        return res;
+    }
+
+    ArrDist arrDist;
+    ServDist servDist;
+};
+
+template <class ArrDist, class ServDist>
+ProcessorSharingSimulation<ArrDist, ServDist> makeProcessorSharingSimulation(ArrDist arrDist, ServDist servDist)
+{
+    return ProcessorSharingSimulation<ArrDist, ServDist>(arrDist, servDist);
+}
@@ -0,0 +1,110 @@
+/************************************************************
+ * Two-machine fluid buffer model (simBuffer of
+ * OnOffFluidModel.py): the parameters, the single-run
+ * simulator and the parallel batch over parameter points.
+ * Shared by OnOffFluidModel.cpp and the parameter sweep.
+ ************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../Common/RandomStreams.hpp"
+#include "../Common/OnlineStats.hpp"
+
+// One parameter point of the model.
+struct FluidParameters
+{
+    double lam;   // failure rate of machine 1 (1 / mean uptime)
+    double mu;    // repair rate of machine 1 (1 / mean downtime)
+    double r1;    // production rate of machine 1
+    double r2;    // consumption rate of machine 2
+    double K;     // buffer size
+};
+
+// Buffer content at the end of every up and down period, keeping only
+// every stride-th point so that long runs give a trace of bounded size.
+struct BufferTrace
+{
+    std::size_t stride = 1;
+    std::vector<double> times;
+    std::vector<double> contents;
+};
+
+// Simulate the buffer up to runLength and return the average production
+// rate, exactly as simBuffer in OnOffFluidModel.py. If 'trace' is given,
+// the (downsampled) buffer content is appended to it.
+template <class Rng>
+double simBuffer(const FluidParameters &par, double runLength, Rng &rng, BufferTrace *trace = nullptr)
+{
+    std::exponential_distribution<double> upDist(par.lam), downDist(par.mu);
+
+    double t = 0.0;       // current time
+    double b = 0.0;       // buffer content
+    double empty = 0.0;   // total time the buffer was empty
+    std::size_t points = 0;
+    auto record = [&]() {
+        if (trace && points++ % trace->stride == 0)
+        {
+            trace->times.push_back(t);
+            trace->contents.push_back(b);
+        }
+    };
+
+    while (t < runLength)
+    {
+        // Machine 1 is up
+        double u = std::min(upDist(rng), runLength - t);
+        t += u;
+        b = std::min(b + u * (par.r1 - par.r2), par.K);
+        record();
+
+        // Machine 1 goes down
+        double d = std::min(downDist(rng), runLength - t);
+        t += d;
+        b -= d * par.r2;
+        if (b < 0)
+        {
+            empty -= b / par.r2;   // how long machine 2 was idle
+            b = 0;
+        }
+        record();
+    }
+    return par.r2 * (1 - empty / t);
+}
+
+// Average production rate of every parameter point over 'replications'
+// independent runs of length runLength. Replication r of point p uses
+// stream p * replications + r of 'seed'; the tasks are handed to nThreads
+// threads through a counter and the per-point statistics are built in
+// replication order afterwards, so the result is deterministic.
+template <class Engine = Xoshiro256StarStar>
+std::vector<RunningStats> simBufferBatch(const std::vector<FluidParameters> &points, double runLength,
+                                         long long replications, std::uint64_t seed, unsigned nThreads)
+{
+    if (nThreads == 0) nThreads = 1;
+    const long long nTasks = static_cast<long long>(points.size()) * replications;
+    std::vector<double> rates(static_cast<std::size_t>(nTasks));
+    std::vector<Engine> taskRng = makeStreamsOf<Engine>(seed, 0, static_cast<std::size_t>(nTasks));
+
+    std::atomic<long long> next(0);
+    auto worker = [&]() {
+        for (long long k = next++; k < nTasks; k = next++)
+        {
+            rates[k] = simBuffer(points[k / replications], runLength, taskRng[k]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers) w.join();
+
+    std::vector<RunningStats> stats(points.size());
+    for (long long k = 0; k < nTasks; k++) stats[k / replications].add(rates[k]);
+    return stats;
+}
@@ -1,37 +1,38 @@
 #include <iostream>
 #include <vector>
-#include <random>
 #include <iomanip>  
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
 
-// Function to simulate a Markov chain for n steps, starting from state x0.
-// p is the transition matrix, where p[i][j] = probability of going from state i to state j.
-std::vector<int> simMarkovChain(const std::vector<std::vector<double>>& p, int x0, int n)
-{
-    // Create a random number generator (seeded by a random device).
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-
-    // This will store the entire sequence of states (including the initial state).
-    std::vector<int> x(n + 1);
-    x[0] = x0;
-
-    // Number of states = number of rows in p.
-    int nrStates = static_cast<int>(p.size());
+#include "MarkovChains.hpp"
 
-    for(int i = 1; i <= n; i++)
+// Usage: MarkovChains [edge-list-file [x0 [nSteps]]]
+//        MarkovChains --trace file [nSteps]
+// Without arguments the built-in 3-state example is simulated.
+int main(int argc, char* argv[])
+{
+    if (argc > 2 && std::string(argv[1]) == "--trace")
+    {
+        long long n = argc > 3 ? std::atoll(argv[3]) : 1000000;
+        std::vector<std::vector<double>> p = {{0.2, 0.3, 0.5}, {0.0, 0.3, 0.7}, {0.5, 0.4, 0.1}};
+        writeMarkovChainTrace(argv[2], AliasTransitions(p), 0, n, 12345);
+        std::cout << "Wrote " << n << " steps to " << argv[2] << "\n";
+        return 0;
+    }
+    if (argc > 1)
     {
-        // Construct a discrete distribution based on the probabilities in row p[x[i-1]].
-        // The next state is chosen according to those probabilities.
-        std::discrete_distribution<int> dist(p[x[i - 1]].begin(), p[x[i - 1]].end());
+        SparseAliasTransitions sparse = loadEdgeList(argv[1]);
+        int x0 = argc > 2 ? std::atoi(argv[2]) : 0;
+        int n = argc > 3 ? std::atoi(argv[3]) : 20;
+        std::vector<int> chain = simMarkovChain(sparse, x0, n, threadLocalGenerator());
 
-        // Sample the next state.
-        x[i] = dist(gen);
+        std::cout << "Loaded " << sparse.size() << " states, " << sparse.nonZeros() << " transitions\n";
+        std::cout << "State after " << n << " steps: " << chain.back() << "\n";
+        return 0;
     }
-    return x;
-}
 
-int main()
-{
     // Define the transition matrix for a 3-state Markov chain.
     // p[i][j] = probability of transitioning from state i to state j.
     std::vector<std::vector<double>> p = {
@@ -52,5 +53,19 @@ int main()
         std::cout << chain[i] << (i + 1 < static_cast<int>(chain.size()) ? " -> " : "\n");
     }
 
+    // Occupancy of 100000 chains at a few times, estimated without paths.
+    long long nChains = 100000;
+    std::vector<long long> times = {1, 2, 5, 20};
+    unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::vector<long long>> occupancy =
+        simMarkovEnsemble(AliasTransitions(p), initialState, nChains, times, nThreads, 12345);
+
+    std::cout << "Occupancy of " << nChains << " chains:\n" << std::fixed << std::setprecision(4);
+    for (size_t k = 0; k < times.size(); k++) {
+        std::cout << "  t = " << std::setw(2) << times[k] << ":";
+        for (long long c : occupancy[k]) std::cout << " " << static_cast<double>(c) / nChains;
+        std::cout << "\n";
+    }
+
     return 0;
 }
@@ -0,0 +1,349 @@
+// Markov chain kernels: dense and sparse alias-table transitions, the
+// edge-list loader, path and ensemble simulators and trace output. Shared by
+// MarkovChains.cpp and the parameter sweep.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/Instrumentation.hpp"
+#include "../Common/RandomStreams.hpp"
+#include "../Common/TraceFile.hpp"
+
+// Build the Walker/Vose alias table of one row with m weights (not
+// necessarily normalised). Afterwards column j is kept with probability
+// prob[j] and replaced by column alias[j] otherwise. small/large are
+// scratch buffers so the caller can reuse them across rows.
+inline void buildAliasRow(const double* weights, int m, double* prob, int* alias,
+                   std::vector<double>& scaled, std::vector<int>& small, std::vector<int>& large)
+{
+    // Rows are normalised, as std::discrete_distribution does.
+    double rowSum = 0.0;
+    for (int j = 0; j < m; j++)
+    {
+        if (weights[j] < 0.0)
+            throw std::invalid_argument("transition probabilities must be non-negative");
+        rowSum += weights[j];
+    }
+    if (!(rowSum > 0.0))
+        throw std::invalid_argument("transition matrix row has no positive entry");
+
+    // Split columns into under- and over-full ones (relative to the
+    // average 1/m) and pair them up.
+    scaled.resize(m);
+    small.clear();
+    large.clear();
+    for (int j = 0; j < m; j++)
+    {
+        scaled[j] = weights[j] * m / rowSum;
+        (scaled[j] < 1.0 ? small : large).push_back(j);
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        int s = small.back(); small.pop_back();
+        int l = large.back(); large.pop_back();
+        prob[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        (scaled[l] < 1.0 ? small : large).push_back(l);
+    }
+    // Whatever is left is full up to rounding error.
+    for (int l : large) { prob[l] = 1.0; alias[l] = l; }
+    for (int s : small) { prob[s] = 1.0; alias[s] = s; }
+}
+
+// Precompiled transition matrix: one Walker/Vose alias table per row.
+// Building costs O(k) per row once; afterwards every transition costs O(1)
+// (one uniform draw, one table lookup), independent of the number of states.
+// All rows are stored back to back in two flat arrays.
+class AliasTransitions
+{
+public:
+    explicit AliasTransitions(const std::vector<std::vector<double>>& p)
+        : nrStates(static_cast<int>(p.size())),
+          prob(p.size() * p.size()),
+          alias(p.size() * p.size())
+    {
+        STOCHSIM_PHASE("markov.alias_setup");
+        STOCHSIM_COUNT(Counter::Allocations, 2);
+        std::vector<double> scaled;
+        std::vector<int> small, large;
+
+        for (int i = 0; i < nrStates; i++)
+        {
+            if (static_cast<int>(p[i].size()) != nrStates)
+                throw std::invalid_argument("transition matrix must be square");
+
+            size_t offset = static_cast<size_t>(i) * nrStates;
+            buildAliasRow(p[i].data(), nrStates, &prob[offset], &alias[offset], scaled, small, large);
+        }
+    }
+
+    int size() const { return nrStates; }
+
+    // Draw the successor of 'state'. A single uniform u picks the column
+    // floor(u*k); its fractional part decides between column and alias.
+    template <class Rng>
+    int next(int state, Rng& gen) const
+    {
+        std::uniform_real_distribution<double> U(0.0, 1.0);
+        double u = U(gen) * nrStates;
+        int j = static_cast<int>(u);
+        if (j >= nrStates) j = nrStates - 1;   // guards against u*k rounding up to k
+        size_t cell = static_cast<size_t>(state) * nrStates + j;
+        return (u - j < prob[cell]) ? j : alias[cell];
+    }
+
+private:
+    int nrStates;
+    std::vector<double> prob;   // prob[i*k + j]: keep column j in row i with this probability
+    std::vector<int> alias;     // alias[i*k + j]: otherwise jump to this state
+};
+
+// One non-zero entry of a sparse transition matrix.
+struct Transition
+{
+    int from;
+    int to;
+    double prob;
+};
+
+// Sparse transition matrix in compressed sparse row (CSR) form, with an
+// alias table over the successors of every row. Memory is O(states + edges)
+// instead of O(states^2), and a transition still costs O(1).
+//
+// Row i occupies positions rowStart[i] .. rowStart[i+1]-1 of the
+// contiguous arrays 'succ' (successor state), 'prob' and 'alias'
+// (where alias already holds the successor state, not its position).
+class SparseAliasTransitions
+{
+public:
+    // Entries may come in any order; duplicates (i, j) are added together.
+    // Every state in [0, nrStates) needs at least one positive entry.
+    SparseAliasTransitions(int nrStates, std::vector<Transition> entries)
+        : nrStates(nrStates),
+          rowStart(static_cast<size_t>(nrStates) + 1, 0)
+    {
+        STOCHSIM_PHASE("markov.sparse_alias_setup");
+        STOCHSIM_COUNT(Counter::Allocations, 4);
+        for (const Transition& e : entries)
+        {
+            if (e.from < 0 || e.from >= nrStates || e.to < 0 || e.to >= nrStates)
+                throw std::out_of_range("transition refers to a state outside [0, nrStates)");
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Transition& a, const Transition& b) {
+            return a.from != b.from ? a.from < b.from : a.to < b.to;
+        });
+
+        // Merge duplicates and fill succ/prob in row order.
+        succ.reserve(entries.size());
+        prob.reserve(entries.size());
+        int lastFrom = -1;
+        for (const Transition& e : entries)
+        {
+            if (e.from == lastFrom && succ.back() == e.to)
+            {
+                prob.back() += e.prob;
+                continue;
+            }
+            lastFrom = e.from;
+            succ.push_back(e.to);
+            prob.push_back(e.prob);
+            rowStart[static_cast<size_t>(e.from) + 1]++;
+        }
+        for (int i = 0; i < nrStates; i++) rowStart[i + 1] += rowStart[i];
+
+        // Replace the weights of every row by its alias table, in place.
+        alias.resize(succ.size());
+        std::vector<double> weights, scaled;
+        std::vector<int> small, large;
+        for (int i = 0; i < nrStates; i++)
+        {
+            size_t start = rowStart[i];
+            int m = static_cast<int>(rowStart[i + 1] - start);
+            if (m == 0)
+                throw std::invalid_argument("state " + std::to_string(i) + " has no outgoing transitions");
+
+            weights.assign(prob.begin() + start, prob.begin() + start + m);
+            buildAliasRow(weights.data(), m, &prob[start], &alias[start], scaled, small, large);
+            for (int j = 0; j < m; j++) alias[start + j] = succ[start + alias[start + j]];
+        }
+    }
+
+    int size() const { return nrStates; }
+    size_t nonZeros() const { return succ.size(); }
+
+    // Draw the successor of 'state': same scheme as AliasTransitions::next,
+    // restricted to the m successors of the row.
+    template <class Rng>
+    int next(int state, Rng& gen) const
+    {
+        std::uniform_real_distribution<double> U(0.0, 1.0);
+        size_t start = rowStart[state];
+        int m = static_cast<int>(rowStart[state + 1] - start);
+        double u = U(gen) * m;
+        int j = static_cast<int>(u);
+        if (j >= m) j = m - 1;
+        size_t cell = start + j;
+        return (u - j < prob[cell]) ? succ[cell] : alias[cell];
+    }
+
+private:
+    int nrStates;
+    std::vector<size_t> rowStart;   // nrStates + 1 row offsets
+    std::vector<int> succ;          // successor state of each entry
+    std::vector<double> prob;       // keep 'succ' with this probability
+    std::vector<int> alias;         // otherwise move to this state
+};
+
+// Load a sparse transition matrix from an edge-list text file with one
+// "from to probability" triple per line. Blank lines and lines starting
+// with '#' are ignored. The number of states is the largest index + 1.
+inline SparseAliasTransitions loadEdgeList(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("cannot open edge list '" + path + "'");
+
+    std::vector<Transition> entries;
+    int maxState = -1;
+    std::string line;
+    long long lineNr = 0;
+    while (std::getline(in, line))
+    {
+        lineNr++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        std::istringstream fields(line);
+        Transition e;
+        if (!(fields >> e.from >> e.to >> e.prob))
+            throw std::runtime_error(path + ":" + std::to_string(lineNr) + ": expected 'from to probability'");
+        entries.push_back(e);
+        maxState = std::max(maxState, std::max(e.from, e.to));
+    }
+    return SparseAliasTransitions(maxState + 1, std::move(entries));
+}
+
+// Function to simulate a Markov chain for n steps, starting from state x0,
+// using a precompiled transition object (AliasTransitions for dense
+// matrices, SparseAliasTransitions for large sparse ones).
+// 'gen' is any random engine, e.g. a stream from RandomStreams; calls from
+// several threads are safe when every thread passes its own generator.
+template <class Transitions, class Rng>
+std::vector<int> simMarkovChain(const Transitions& p, int x0, int n, Rng& gen)
+{
+    // This will store the entire sequence of states (including the initial state).
+    std::vector<int> x(n + 1);
+    STOCHSIM_COUNT(Counter::Allocations, 1);
+    x[0] = x0;
+
+    for(int i = 1; i <= n; i++)
+    {
+        // Sample the next state from the alias table of row x[i-1].
+        x[i] = p.next(x[i - 1], gen);
+    }
+    return x;
+}
+
+// Function to simulate a Markov chain for n steps, starting from state x0.
+// p is the transition matrix, where p[i][j] = probability of going from state i to state j.
+// The alias tables are built once here; to simulate many chains with the same
+// matrix, build an AliasTransitions yourself and call the overload above.
+// Uses this thread's own randomly seeded generator.
+inline std::vector<int> simMarkovChain(const std::vector<std::vector<double>>& p, int x0, int n)
+{
+    return simMarkovChain(AliasTransitions(p), x0, n, threadLocalGenerator());
+}
+
+// Simulate n steps from x0 on stream 0 of 'seed' and write the states
+// x_0 .. x_n to a trace file as 32-bit integers, one chunk at a time, so
+// the path is never held in memory.
+template <class Transitions>
+void writeMarkovChainTrace(const std::string& path, const Transitions& p, int x0, long long n, std::uint64_t seed)
+{
+    TraceWriter trace(path, seed, {{"state", TraceType::Int32}},
+                      formatTraceParams({{"x0", static_cast<double>(x0)}, {"n", static_cast<double>(n)},
+                                         {"states", static_cast<double>(p.size())}}));
+    Xoshiro256StarStar gen = makeStream(seed, 0);
+    int state = x0;
+    trace.appendRow(state);
+    for (long long i = 1; i <= n; i++)
+    {
+        state = p.next(state, gen);
+        trace.appendRow(state);
+    }
+}
+
+// Number of chains that share one RNG stream in simMarkovEnsemble.
+constexpr long long ENSEMBLE_BLOCK = 1024;
+
+// Simulate nChains independent copies of the chain, all started in x0, and
+// return the occupancy histogram at each of the (ascending) recordTimes:
+// counts[k][s] = number of chains in state s at time recordTimes[k].
+//
+// All chains advance together: their current states live in one array,
+// which is cut into blocks of ENSEMBLE_BLOCK chains. Threads pick up whole
+// blocks; block b always uses stream b of 'seed', so the result depends on
+// (seed, nChains) only, not on the number of threads. The threads meet at
+// every record time and the histogram is built from the state array, so no
+// paths are stored and memory is O(nChains + states * recordTimes).
+// The engine type is a template parameter, e.g.
+// simMarkovEnsemble<AliasTransitions, Philox4x32>(...) for counter-based streams.
+template <class Transitions, class Engine = Xoshiro256StarStar>
+std::vector<std::vector<long long>> simMarkovEnsemble(const Transitions& p, int x0, long long nChains,
+                                                      const std::vector<long long>& recordTimes,
+                                                      unsigned nThreads, std::uint64_t seed)
+{
+    if (nThreads == 0) nThreads = 1;
+
+    std::vector<int> states(static_cast<size_t>(nChains), x0);
+    long long nBlocks = (nChains + ENSEMBLE_BLOCK - 1) / ENSEMBLE_BLOCK;
+
+    // One stream per block.
+    std::vector<Engine> blockRng = makeStreamsOf<Engine>(seed, 0, static_cast<size_t>(nBlocks));
+
+    std::vector<std::vector<long long>> counts(recordTimes.size(), std::vector<long long>(p.size(), 0));
+    long long now = 0;
+    for (size_t k = 0; k < recordTimes.size(); k++)
+    {
+        long long steps = recordTimes[k] - now;
+        if (steps < 0)
+            throw std::invalid_argument("record times must be ascending");
+
+        // Advance every block by 'steps' transitions. Blocks are handed out
+        // through a shared counter; the chains themselves share nothing.
+        std::atomic<long long> nextBlock(0);
+        auto worker = [&]() {
+            for (long long b = nextBlock++; b < nBlocks; b = nextBlock++)
+            {
+                Engine& rng = blockRng[static_cast<size_t>(b)];
+                int* x = states.data() + b * ENSEMBLE_BLOCK;
+                long long m = std::min(ENSEMBLE_BLOCK, nChains - b * ENSEMBLE_BLOCK);
+                for (long long t = 0; t < steps; t++)
+                {
+                    for (long long c = 0; c < m; c++) x[c] = p.next(x[c], rng);
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker);
+        worker();
+        for (auto& w : workers) w.join();
+        now = recordTimes[k];
+
+        for (int s : states) counts[k][s]++;
+    }
+    return counts;
+}
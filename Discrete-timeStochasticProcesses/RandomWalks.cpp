@@ -1,37 +1,48 @@
 #include <iostream>
 #include <vector>
-#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <string>
 
-// Function to simulate a simple random walk with prob p of stepping +1
-//Return a vector of positions s_0 s_1 s_2...
+#include "RandomWalks.hpp"
 
-std::vector<int> simRandomWalk(double p, int n) {
-
-    static std::random_device rd; //non-det seed source
-    static std::mt19937 gen(rd()); //random number generator
-    std::bernoulli_distribution dist(p); //will return true with prob p
-
-    //create a vectro to hold the position
-    std::vector<int> positions(n+1, 0);
+// Usage: RandomWalks [--trace file [n]]
+int main(int argc, char* argv[]) {
+    double p = 0.5;
+    long long n = 100;
 
-    for(int i = 1 ; i <= n; i++) {
-        int step = dist(gen) ? +1 : -1;
-        positions[i] = positions[i-1] + step;
+    if (argc > 2 && std::string(argv[1]) == "--trace") {
+        long long nTrace = argc > 3 ? std::atoll(argv[3]) : 100000000;
+        writeRandomWalkTrace(argv[2], p, nTrace, 12345);
+        std::cout << "Wrote " << nTrace << " steps to " << argv[2] << "\n";
+        return 0;
     }
 
-    return positions;
-}
-
-int main() {
-    double p = 0.5;
-    int n = 100;
-
-    std::vector<int> path = simRandomWalk(p,n);
-    for (int i = 0; i <= n; ++i)
+    std::vector<long long> path = simRandomWalk(p,n);
+    for (long long i = 0; i <= n; ++i)
     {
-        std::cout << "Step " << i << ": " << path[i] << std::endl;
+        std::cout << "Step " << i << ": " << path[i] << '\n';
     }
 
+    // A much longer walk summarised on the fly, without storing the path,
+    // once step by step and once with the bit-parallel kernel. Both use
+    // stream 0 of a fixed seed, so the run is reproducible.
+    long long nLong = 100000000;
+    RandomStreams streams(12345);
+    for (bool fast : {false, true}) {
+        Xoshiro256StarStar rng = streams.stream(0);
+        auto t0 = std::chrono::steady_clock::now();
+        WalkStats stats = fast ? simRandomWalkStatsFast(p, nLong, 1000, rng)
+                               : simRandomWalkStats(p, nLong, 1000, rng);
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << (fast ? "bit-parallel" : "step-by-step") << ": after " << nLong
+                  << " steps: position " << stats.finalPosition
+                  << ", max " << stats.maxPosition << ", min " << stats.minPosition
+                  << ", first hit of 1000 at step " << stats.hittingTime
+                  << " (" << nLong / sec / 1e6 << " Msteps/s)\n";
+    }
+    std::cout.flush();
+
     return 0;
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,261 @@
+// Simple random walk kernels: streaming, chunked and bit-parallel
+// simulators, packed paths and trace output. Shared by RandomWalks.cpp and
+// the parameter sweep.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../Common/RandomStreams.hpp"
+#include "../Common/TraceFile.hpp"
+
+// All simulators take the random number generator explicitly (any standard
+// engine, or a stream from RandomStreams), so concurrent calls from several
+// threads are safe as long as each thread uses its own generator.
+
+// Streaming simple random walk with prob p of stepping +1.
+// Instead of storing the path, visit(i, s_i) is called for i = 0..n as the
+// walk is generated, so memory stays constant for any n. Step counts and
+// positions are 64-bit, so walks longer than 2^31 steps are fine.
+template <class Rng, class Visitor>
+void simRandomWalk(double p, long long n, Rng& gen, Visitor&& visit) {
+    std::bernoulli_distribution dist(p); //will return true with prob p
+
+    long long position = 0;
+    visit(0LL, position);
+    for(long long i = 1 ; i <= n; i++) {
+        position += dist(gen) ? +1 : -1;
+        visit(i, position);
+    }
+}
+
+// Same walk, handed out in fixed-size pieces: visitChunk(firstStep, positions, count)
+// receives s_firstStep .. s_{firstStep+count-1}. Useful for writing a path
+// to disk or post-processing it in blocks; only one chunk is kept in memory.
+template <class Rng, class ChunkVisitor>
+void simRandomWalkChunked(double p, long long n, std::size_t chunkSize, Rng& gen, ChunkVisitor&& visitChunk) {
+    std::vector<long long> chunk;
+    chunk.reserve(chunkSize);
+    long long firstStep = 0;
+
+    simRandomWalk(p, n, gen, [&](long long i, long long position) {
+        chunk.push_back(position);
+        if (chunk.size() == chunkSize || i == n) {
+            visitChunk(firstStep, chunk.data(), chunk.size());
+            firstStep = i + 1;
+            chunk.clear();
+        }
+    });
+}
+
+// Running summary of a walk, for when the path itself is not needed.
+struct WalkStats {
+    long long finalPosition = 0;
+    long long maxPosition = 0;
+    long long minPosition = 0;
+    long long hittingTime = -1; // first i with s_i == level, -1 if never reached
+};
+
+// Simulate n steps and only keep the summary; 'level' is the target for
+// the hitting time (a level of 0 is hit at time 0).
+template <class Rng>
+WalkStats simRandomWalkStats(double p, long long n, long long level, Rng& gen) {
+    WalkStats stats;
+    simRandomWalk(p, n, gen, [&](long long i, long long position) {
+        stats.maxPosition = std::max(stats.maxPosition, position);
+        stats.minPosition = std::min(stats.minPosition, position);
+        if (stats.hittingTime < 0 && position == level) stats.hittingTime = i;
+        stats.finalPosition = position;
+    });
+    return stats;
+}
+
+// ---- Bit-parallel walks ----
+// A block of 64 steps is one 64-bit word: bit k set means step k is +1.
+// For p = 0.5 a raw RNG word already is such a block; for other p the
+// block is built from 64 comparisons of 32-bit uniforms against p * 2^32.
+// The displacement of a block is 2*popcount - 64.
+
+// 64-bit random words from any engine with a 64-bit range (e.g.
+// Xoshiro256StarStar or std::mt19937_64).
+template <class Rng64>
+std::uint64_t randomWord(Rng64& rng) {
+    static_assert(Rng64::min() == 0 && Rng64::max() == UINT64_MAX, "engine must produce 64-bit words");
+    return rng();
+}
+
+// Threshold for "step is +1" on a 32-bit uniform; p = 1 maps to 2^32.
+inline std::uint64_t stepThreshold(double p) {
+    if (!(p >= 0.0 && p <= 1.0)) throw std::invalid_argument("p must be in [0, 1]");
+    return static_cast<std::uint64_t>(p * 4294967296.0);
+}
+
+// Next block of 64 steps. Each RNG word gives two 32-bit uniforms.
+template <class Rng64>
+std::uint64_t stepBlock(Rng64& rng, bool symmetric, std::uint64_t threshold) {
+    if (symmetric) return randomWord(rng);
+
+    std::uint64_t mask = 0;
+    for (int k = 0; k < 64; k += 2) {
+        std::uint64_t w = randomWord(rng);
+        mask |= static_cast<std::uint64_t>((w & 0xffffffffULL) < threshold) << k;
+        mask |= static_cast<std::uint64_t>((w >> 32) < threshold) << (k + 1);
+    }
+    return mask;
+}
+
+// Net displacement and the highest / lowest partial sum (after 1..8 steps)
+// of the 8 steps encoded in one byte, lowest bit first.
+struct ByteSteps {
+    int net, max, min;
+};
+
+inline const std::array<ByteSteps, 256>& byteStepTable() {
+    static const std::array<ByteSteps, 256> table = [] {
+        std::array<ByteSteps, 256> t{};
+        for (int b = 0; b < 256; b++) {
+            int s = 0, mx = -8, mn = 8;
+            for (int k = 0; k < 8; k++) {
+                s += ((b >> k) & 1) ? +1 : -1;
+                mx = std::max(mx, s);
+                mn = std::min(mn, s);
+            }
+            t[b] = {s, mx, mn};
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Advance 'stats' over 'count' (<= 64) steps stored in 'bits', the first of
+// which is step number firstStep. Blocks that cannot change max, min or the
+// hitting time only cost a popcount; otherwise they are scanned a byte at a
+// time with byteStepTable, and bit by bit only in the byte that hits 'level'.
+inline void advanceStats(WalkStats& stats, std::uint64_t bits, int count, long long firstStep, long long level) {
+    long long pos = stats.finalPosition;
+    if (count == 64 && pos + 64 <= stats.maxPosition && pos - 64 >= stats.minPosition &&
+        (stats.hittingTime >= 0 || level > pos + 64 || level < pos - 64)) {
+        stats.finalPosition = pos + 2 * __builtin_popcountll(bits) - 64;
+        return;
+    }
+
+    const std::array<ByteSteps, 256>& table = byteStepTable();
+    int k = 0;
+    for (; k + 8 <= count; k += 8) {
+        const ByteSteps& b = table[(bits >> k) & 0xff];
+        stats.maxPosition = std::max(stats.maxPosition, pos + b.max);
+        stats.minPosition = std::min(stats.minPosition, pos + b.min);
+        if (stats.hittingTime < 0 && level >= pos + b.min && level <= pos + b.max) {
+            long long q = pos;
+            for (int j = 0; j < 8; j++) {
+                q += ((bits >> (k + j)) & 1) ? +1 : -1;
+                if (q == level) { stats.hittingTime = firstStep + k + j; break; }
+            }
+        }
+        pos += b.net;
+    }
+    // Steps that do not fill a whole byte (only at the end of the walk).
+    for (; k < count; k++) {
+        pos += ((bits >> k) & 1) ? +1 : -1;
+        stats.maxPosition = std::max(stats.maxPosition, pos);
+        stats.minPosition = std::min(stats.minPosition, pos);
+        if (stats.hittingTime < 0 && pos == level) stats.hittingTime = firstStep + k;
+    }
+    stats.finalPosition = pos;
+}
+
+// Bit-parallel counterpart of simRandomWalkStats: same summary, 64 steps per
+// block. p = 0.5 uses one RNG word per block, other p one comparison per step.
+template <class Rng64>
+WalkStats simRandomWalkStatsFast(double p, long long n, long long level, Rng64& rng) {
+    const bool symmetric = (p == 0.5);
+    const std::uint64_t threshold = stepThreshold(p);
+
+    WalkStats stats;
+    if (level == 0) stats.hittingTime = 0;
+    for (long long done = 0; done < n; done += 64) {
+        int count = static_cast<int>(std::min<long long>(64, n - done));
+        advanceStats(stats, stepBlock(rng, symmetric, threshold), count, done + 1, level);
+    }
+    return stats;
+}
+
+// A walk kept as its step bits only: 1 bit per step instead of 8 bytes per
+// position. Individual positions or the whole path are rebuilt on request.
+struct PackedWalk {
+    long long nSteps = 0;
+    std::vector<std::uint64_t> blocks; // step i (1-based) is bit (i-1)%64 of blocks[(i-1)/64]
+
+    // Position s_i, computed from popcounts in O(i / 64).
+    long long positionAt(long long i) const {
+        long long fullBlocks = i / 64;
+        long long ones = 0;
+        for (long long b = 0; b < fullBlocks; b++) ones += __builtin_popcountll(blocks[b]);
+        int rest = static_cast<int>(i % 64);
+        if (rest > 0) ones += __builtin_popcountll(blocks[fullBlocks] & ((std::uint64_t{1} << rest) - 1));
+        return 2 * ones - i;
+    }
+
+    // All positions s_0 .. s_n, like simRandomWalk(p, n).
+    std::vector<long long> unpack() const {
+        std::vector<long long> positions;
+        positions.reserve(static_cast<std::size_t>(nSteps) + 1);
+        long long pos = 0;
+        positions.push_back(pos);
+        for (long long i = 0; i < nSteps; i++) {
+            pos += ((blocks[i / 64] >> (i % 64)) & 1) ? +1 : -1;
+            positions.push_back(pos);
+        }
+        return positions;
+    }
+};
+
+template <class Rng64>
+PackedWalk simRandomWalkPacked(double p, long long n, Rng64& rng) {
+    const bool symmetric = (p == 0.5);
+    const std::uint64_t threshold = stepThreshold(p);
+
+    PackedWalk walk;
+    walk.nSteps = n;
+    walk.blocks.resize(static_cast<std::size_t>((n + 63) / 64));
+    for (std::uint64_t& block : walk.blocks) block = stepBlock(rng, symmetric, threshold);
+    return walk;
+}
+
+// Write s_0 .. s_n of a walk on stream 0 of 'seed' to a trace file. The
+// column is delta-encoded as 8-bit steps, i.e. one byte per step.
+inline void writeRandomWalkTrace(const std::string& path, double p, long long n, std::uint64_t seed) {
+    TraceWriter trace(path, seed, {{"position", TraceType::Int8, TraceEncoding::Delta}},
+                      formatTraceParams({{"p", p}, {"n", static_cast<double>(n)}}));
+    Xoshiro256StarStar rng = makeStream(seed, 0);
+    simRandomWalkChunked(p, n, 65536, rng, [&](long long, const long long* positions, std::size_t count) {
+        trace.appendValues(positions, count);
+    });
+}
+
+// Function to simulate a simple random walk with prob p of stepping +1
+//Return a vector of positions s_0 s_1 s_2...
+// This stores the full path; prefer the streaming versions above for long walks.
+template <class Rng>
+std::vector<long long> simRandomWalk(double p, long long n, Rng& gen) {
+    //create a vectro to hold the position
+    std::vector<long long> positions;
+    positions.reserve(static_cast<std::size_t>(n) + 1);
+
+    simRandomWalk(p, n, gen, [&](long long, long long position) {
+        positions.push_back(position);
+    });
+
+    return positions;
+}
+
+// Convenience overload using this thread's own randomly seeded generator.
+inline std::vector<long long> simRandomWalk(double p, long long n) {
+    return simRandomWalk(p, n, threadLocalGenerator());
+}
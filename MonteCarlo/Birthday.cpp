@@ -0,0 +1,170 @@
+// Native version of Birthday.py: the probability that among n people two
+// share a birthday, for every n = 1..maxN at once.
+//
+// Every replicate adds people one at a time until the first repeated
+// birthday, keeping the days seen in a 365-bit bitset (six 64-bit words),
+// and records the group size at which the first collision happened. The
+// histogram of those sizes gives the whole curve P(n) = P(first collision
+// <= n) from a single pass.
+//
+// Compile example:
+//   g++ -std=c++17 -O3 -march=native -pthread Birthday.cpp -o Birthday
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include "../Common/RandomStreams.hpp"
+#include "../Common/SequentialEstimator.hpp"
+
+using namespace std;
+
+constexpr int DAYS = 365;
+constexpr int BITSET_WORDS = (DAYS + 63) / 64;   // 6
+
+// Replicates per RNG stream: block b always uses stream b of the seed.
+constexpr long long BIRTHDAY_BLOCK = 1 << 16;
+
+// Day in [0, DAYS) from 32 random bits by multiply-shift (bias below
+// DAYS / 2^32, far under the Monte Carlo error).
+inline int dayOf(uint32_t bits) {
+    return static_cast<int>((static_cast<uint64_t>(bits) * DAYS) >> 32);
+}
+
+// Size of the group at which the first shared birthday appears, or
+// maxN + 1 if the first maxN people all have different birthdays. Each
+// engine word gives two birthdays.
+template <class Engine>
+int firstCollision(Engine &rng, int maxN) {
+    uint64_t seen[BITSET_WORDS] = {0, 0, 0, 0, 0, 0};
+    uint64_t word = 0;
+    for (int person = 1; person <= maxN; person++) {
+        uint32_t bits;
+        if (person & 1) {
+            word = rng();
+            bits = static_cast<uint32_t>(word);
+        } else {
+            bits = static_cast<uint32_t>(word >> 32);
+        }
+        int day = dayOf(bits);
+        uint64_t mask = uint64_t{1} << (day & 63);
+        if (seen[day >> 6] & mask) return person;
+        seen[day >> 6] |= mask;
+    }
+    return maxN + 1;
+}
+
+// Histogram of the first-collision size over many replicates.
+// counts[n] is the number of replicates whose first collision was at group
+// size n (n = 2..maxN), counts[maxN + 1] those without collision up to maxN.
+struct BirthdayCurve {
+    int maxN = 0;
+    long long replicates = 0;
+    vector<long long> counts;
+
+    // Estimated P(n): fraction of replicates with a collision among n people.
+    vector<double> probabilities() const {
+        vector<double> p(maxN + 1, 0.0);
+        long long collided = 0;
+        for (int n = 1; n <= maxN; n++) {
+            collided += counts[n];
+            p[n] = static_cast<double>(collided) / replicates;
+        }
+        return p;
+    }
+};
+
+// Runs 'replicates' replicates on nThreads threads in blocks of
+// BIRTHDAY_BLOCK, each block with its own counts, summed at the end;
+// the result depends only on (replicates, maxN, seed).
+template <class Engine = Xoshiro256StarStar>
+BirthdayCurve simulateBirthdayCurve(long long replicates, int maxN, uint64_t seed, unsigned nThreads) {
+    if (nThreads == 0) nThreads = 1;
+    if (maxN > DAYS) maxN = DAYS;   // 366 people always collide
+    const long long nBlocks = (replicates + BIRTHDAY_BLOCK - 1) / BIRTHDAY_BLOCK;
+    vector<Engine> blockRng = makeStreamsOf<Engine>(seed, 0, static_cast<size_t>(nBlocks));
+    vector<vector<long long>> threadCounts(nThreads, vector<long long>(maxN + 2, 0));
+
+    atomic<long long> next(0);
+    auto worker = [&](unsigned w) {
+        vector<long long> &counts = threadCounts[w];
+        for (long long b = next++; b < nBlocks; b = next++) {
+            long long reps = min(BIRTHDAY_BLOCK, replicates - b * BIRTHDAY_BLOCK);
+            for (long long r = 0; r < reps; r++) counts[firstCollision(blockRng[b], maxN)]++;
+        }
+    };
+    vector<thread> workers;
+    for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker, w);
+    worker(0);
+    for (auto &w : workers) w.join();
+
+    BirthdayCurve curve;
+    curve.maxN = maxN;
+    curve.replicates = replicates;
+    curve.counts.assign(maxN + 2, 0);
+    for (const vector<long long> &counts : threadCounts) {
+        for (int n = 0; n <= maxN + 1; n++) curve.counts[n] += counts[n];
+    }
+    return curve;
+}
+
+// 1 - prod_{k<n} (1 - k/DAYS).
+double exactProbability(int n) {
+    double distinct = 1.0;
+    for (int k = 1; k < n; k++) distinct *= 1.0 - static_cast<double>(k) / DAYS;
+    return 1.0 - distinct;
+}
+
+// Usage: Birthday [--reps R] [--max N] [--threads T] [--seed S]
+//                 [--n n --abs H | --rel R]
+// Prints P(n) for n = 10, 20, ..., maxN next to the exact value. With --abs
+// or --rel only P(n) for the given n is estimated, in chunks until its 95%
+// CI half-width meets the target.
+int main(int argc, char *argv[]) {
+    long long replicates = 10000000;
+    int maxN = 100;
+    int n = 50;
+    unsigned nThreads = max(1u, thread::hardware_concurrency());
+    uint64_t seed = 12345;
+    PrecisionTarget target;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--reps") == 0 && a + 1 < argc) replicates = strtoll(argv[++a], nullptr, 10);
+        else if (strcmp(argv[a], "--max") == 0 && a + 1 < argc) maxN = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--n") == 0 && a + 1 < argc) n = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) nThreads = static_cast<unsigned>(strtoul(argv[++a], nullptr, 10));
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) seed = strtoull(argv[++a], nullptr, 10);
+        else if (strcmp(argv[a], "--abs") == 0 && a + 1 < argc) target.absolute = strtod(argv[++a], nullptr);
+        else if (strcmp(argv[a], "--rel") == 0 && a + 1 < argc) target.relative = strtod(argv[++a], nullptr);
+    }
+
+    if (target.absolute > 0 || target.relative > 0) {
+        SequentialResult p = runUntilPrecision([n](Xoshiro256StarStar &rng, long long reps) {
+            long long collided = 0;
+            for (long long r = 0; r < reps; r++) collided += firstCollision(rng, n) <= n;
+            return static_cast<double>(collided) / static_cast<double>(reps);
+        }, 10000, target, seed, nThreads);
+        std::cout << "P(" << n << ") = " << setprecision(6) << p.estimate << " +- " << setprecision(3) << p.halfWidth
+                  << " (exact " << setprecision(6) << exactProbability(n) << "), " << p.samples << " replicates, "
+                  << p.wallSeconds << " s" << std::endl;
+        return 0;
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    BirthdayCurve curve = simulateBirthdayCurve(replicates, maxN, seed, nThreads);
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    vector<double> p = curve.probabilities();
+
+    std::cout << "   n   estimate     exact\n" << fixed;
+    for (int k = 10; k <= curve.maxN; k += 10) {
+        std::cout << setw(4) << k << "   " << setprecision(6) << p[k] << "  " << exactProbability(k) << "\n";
+    }
+    std::cout << "P(23) = " << p[min(23, curve.maxN)] << "; " << replicates << " replicates on " << nThreads
+              << " threads in " << setprecision(3) << sec << " s (" << replicates / sec / 1e6 << " M/s)" << std::endl;
+    return 0;
+}
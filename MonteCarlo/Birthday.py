@@ -1,5 +1,7 @@
 import random
+import time
 import numpy as np
+from scipy import stats
 
 rng = np.random.default_rng()
 
@@ -13,14 +15,36 @@ def sameBirthday(birthdays):
             return True
     return False
 
-n = 50
-nrRuns = 100000
-counter = 0
-for i in range(nrRuns) :
-    birthdays = rng.integers(0,365, size = n)
-    if sameBirthday(birthdays) :
-        counter += 1      
-
+def estimateProbability(n, absTol=None, relTol=None, chunk=1000, minBatches=20, maxRuns=10**7, confidence=0.95):
+    """
+    Runs chunks of `chunk` runs until the confidence interval of the
+    probability is narrow enough: half-width <= absTol, or <= relTol times
+    the estimate. Every chunk's fraction is one batch mean; the batch means
+    are accumulated with Welford's update and the interval uses Student's t
+    with (batches - 1) degrees of freedom.
+    Returns:
+        (estimate, half-width, runs used, wall time in seconds)
+    """
+    start = time.perf_counter()
+    batches, mean, m2 = 0, 0.0, 0.0
+    halfWidth = float("inf")
+    while batches * chunk < maxRuns:
+        counter = 0
+        for i in range(chunk):
+            if sameBirthday(rng.integers(0, 365, size=n)):
+                counter += 1
+        batches += 1
+        delta = counter / chunk - mean
+        mean += delta / batches
+        m2 += delta * (counter / chunk - mean)
+        if batches < max(minBatches, 2):
+            continue
+        halfWidth = stats.t.ppf(0.5 * (1 + confidence), batches - 1) * np.sqrt(m2 / (batches - 1) / batches)
+        if (absTol is not None and halfWidth <= absTol) or (relTol is not None and halfWidth <= relTol * abs(mean)):
+            break
+    return mean, halfWidth, batches * chunk, time.perf_counter() - start
 
-estimated_probability = counter / nrRuns
-print(f"Estimated probability (n={n}): {estimated_probability:.4f}")        
+n = 50
+estimated_probability, halfWidth, nrRuns, seconds = estimateProbability(n, absTol=0.002)
+print(f"Estimated probability (n={n}): {estimated_probability:.4f} +- {halfWidth:.4f} "
+      f"({nrRuns} runs, {seconds:.2f} s)")
@@ -1,28 +1,291 @@
+// Compile example:
+//   g++ -std=c++17 -O3 -march=native -pthread EstimatorOfPi.cpp -o EstimatorOfPi
+// -march=native enables the AVX2 / AVX-512 hit test when the CPU has it;
+// without it the portable branch-free scalar loop is used.
 #include <iostream>
 #include <random>
+#include <atomic>
 #include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include "../Common/RandomStreams.hpp"
+#include "../Common/Philox.hpp"
+#include "../Common/OnlineStats.hpp"
+#include "../Common/Sobol.hpp"
+#include "../Common/VarianceReduction.hpp"
+#include "../Common/SequentialEstimator.hpp"
+#include "EstimatorOfPi.hpp"
 
 using namespace std;
 
-int main() {
-    const long long N = 100000000;
+// Parallel estimator: splits the N samples over nThreads workers, worker k
+// uses stream k of 'seed'. The per-thread counts are summed in thread order
+// after join(), so a given (seed, nThreads) always gives the same estimate.
+// With batched = true each worker runs the SIMD kernel; its lanes are
+// xoshiro streams k*PI_LANES .. k*PI_LANES + PI_LANES-1. Otherwise worker k
+// uses stream k of the engine picked by the template parameter.
+template <class Engine = Xoshiro256StarStar>
+double estimatePiParallel(long long N, unsigned nThreads, uint64_t seed, bool batched = false) {
+    if (nThreads == 0) nThreads = 1;
 
-    //Initialize random generator and distribution
-    mt19937_64 rng (12345);
-    uniform_real_distribution<double> dist(-1.0, 1.0);
+    RandomStreams streams(seed);
+    vector<long long> counts(nThreads, 0);
+    vector<thread> workers;
+    workers.reserve(nThreads);
+
+    for (unsigned k = 0; k < nThreads; k++) {
+        // The first N % nThreads workers take one extra sample.
+        long long share = N / nThreads + (k < N % nThreads ? 1 : 0);
+        workers.emplace_back([&counts, &streams, k, share, seed, batched]() {
+            if (batched) {
+                PiLanes rng(streams.stream(static_cast<uint64_t>(k) * PI_LANES));
+                counts[k] = countInsideCircleBatched(rng, share);
+            } else {
+                Engine rng = makeStreamOf<Engine>(seed, k);
+                counts[k] = countInsideCircle(rng, share);
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
 
     long long pointsInsideCircle = 0;
-    for (long long i = 0; i < N; i++) {
-        double x = dist(rng);
-        double y = dist(rng);
-        if(x*x + y*y <= 1.0) {
-            pointsInsideCircle++;
+    for (long long c : counts) pointsInsideCircle += c;
+
+    return 4.0 * (static_cast<double>(pointsInsideCircle) / static_cast<double>(N));
+}
+
+// ---- Quasi-Monte Carlo ----
+// The same hit test on the points of any source with next(double *point),
+// i.e. SobolSequence or PseudoRandomPoints: its unit square is mapped to
+// [-1,1]^2, so the estimate only depends on how evenly the source covers it.
+template <class PointSource>
+long long countInsideCircleFrom(PointSource &points, long long n) {
+    long long inside = 0;
+    double p[2];
+    for (long long i = 0; i < n; i++) {
+        points.next(p);
+        double x = 2.0 * p[0] - 1.0;
+        double y = 2.0 * p[1] - 1.0;
+        inside += (x*x + y*y <= 1.0);
+    }
+    return inside;
+}
+
+// Randomized QMC: 'replicates' independent scramblings of the 2-d Sobol
+// sequence (replicate r scrambled by stream r of 'seed') with N / replicates
+// points each, handed to nThreads threads through a counter. N is rounded
+// down to a multiple of 'replicates', which must lie in [1, N]. The replicate
+// estimates are i.i.d. and unbiased, so their statistics give the estimate
+// (mean) and its error (standardError) without any model of the QMC error.
+RunningStats estimatePiRQMC(long long N, long long replicates, unsigned nThreads, uint64_t seed) {
+    if (nThreads == 0) nThreads = 1;
+    const long long perReplicate = N / replicates;
+    vector<Xoshiro256StarStar> scramblers = makeStreamsOf<Xoshiro256StarStar>(seed, 0, replicates);
+    vector<double> estimates(replicates);
+
+    atomic<long long> next(0);
+    auto worker = [&]() {
+        for (long long r = next++; r < replicates; r = next++) {
+            SobolSequence points(2, scramblers[r]);
+            estimates[r] = 4.0 * static_cast<double>(countInsideCircleFrom(points, perReplicate)) / perReplicate;
+        }
+    };
+    vector<thread> workers;
+    for (unsigned w = 1; w < nThreads; w++) workers.emplace_back(worker);
+    worker();
+    for (auto &w : workers) w.join();
+
+    RunningStats stats;
+    for (double e : estimates) stats.add(e);
+    return stats;
+}
+
+// ---- Variance reduction ----
+// pi = 4 P(u^2 + v^2 <= 1) for (u, v) uniform on the unit square (the
+// quarter circle: on [-1,1]^2 the antithetic point (-x, -y) would give the
+// same hit). Each estimator runs N samples in blocks of VR_BLOCK, block b on
+// stream b of 'seed', and is compared with the crude estimator:
+//  - antithetic: (u, v) together with (1 - u, 1 - v)
+//  - control variate: c = u^2 + v^2, E[c] = 2/3, strongly (negatively)
+//    correlated with the hit
+//  - stratified: a 64 x 64 grid of cells, N / 4096 points in each
+// Importance sampling is left out here: the hit probability is not small,
+// so there is no region to concentrate the samples on (see the compound
+// Poisson tail in PoissonProcess.cpp for that).
+constexpr long long VR_BLOCK = 1 << 20;
+
+inline double quarterCircleHit(double u, double v) {
+    return 4.0 * (u*u + v*v <= 1.0);
+}
+
+void compareVarianceReduction(long long N, unsigned nThreads, uint64_t seed) {
+    const long long nBlocks = (N + VR_BLOCK - 1) / VR_BLOCK;
+    auto blockSize = [&](long long b) { return min(VR_BLOCK, N - b * VR_BLOCK); };
+    auto draw = [](auto &rng) { return toUnitDouble(rng()); };
+    EstimatorComparison comparison;
+
+    comparison.run("crude", [&]() {
+        return runInBlocks(RunningStats(), nBlocks, seed, nThreads, [&](long long b, Xoshiro256StarStar &rng, RunningStats &s) {
+            s.merge(crudeEstimate([&](auto &r) { double u = draw(r); return quarterCircleHit(u, draw(r)); }, blockSize(b), rng));
+        });
+    });
+    comparison.run("antithetic", [&]() {
+        return runInBlocks(RunningStats(), nBlocks, seed, nThreads, [&](long long b, Xoshiro256StarStar &rng, RunningStats &s) {
+            s.merge(antitheticEstimate([&](auto &r) { double u = draw(r); return quarterCircleHit(u, draw(r)); }, blockSize(b) / 2, rng));
+        });
+    }, 2);
+    comparison.run("control", [&]() {
+        return runInBlocks(ControlVariateStats(2.0 / 3.0), nBlocks, seed, nThreads,
+                           [&](long long b, Xoshiro256StarStar &rng, ControlVariateStats &s) {
+            s.merge(controlVariateEstimate([&](auto &r) {
+                double u = draw(r), v = draw(r);
+                return make_pair(quarterCircleHit(u, v), u*u + v*v);
+            }, 2.0 / 3.0, blockSize(b), rng));
+        });
+    });
+    const int K = 64;
+    const vector<double> cells(K * K, 1.0 / (K * K));
+    comparison.run("stratified", [&]() {
+        return runInBlocks(StratifiedStats(cells), nBlocks, seed, nThreads, [&](long long b, Xoshiro256StarStar &rng, StratifiedStats &s) {
+            s.merge(stratifiedEstimate([&](size_t k, auto &r) {
+                double u = (static_cast<double>(k % K) + draw(r)) / K;
+                double v = (static_cast<double>(k / K) + draw(r)) / K;
+                return quarterCircleHit(u, v);
+            }, cells, blockSize(b), rng));
+        });
+    });
+    comparison.print(std::cout);
+}
+
+// ---- Run until a precision target ----
+// Chunks of PI_CHUNK samples of the batched kernel.
+
+SequentialResult estimatePiToPrecision(const PrecisionTarget &target, unsigned nThreads, uint64_t seed) {
+    return runUntilPrecision([](Xoshiro256StarStar &rng, long long n) {
+        PiLanes lanes(rng);
+        return 4.0 * static_cast<double>(countInsideCircleBatched(lanes, n)) / static_cast<double>(n);
+    }, PI_CHUNK, target, seed, nThreads, PI_LANES);
+}
+
+// Single-core throughput of the original loop, the scalar xoshiro kernel and
+// the batched kernel on N samples each.
+void runBenchmark(long long N, uint64_t seed) {
+    using clock = chrono::steady_clock;
+
+    auto t0 = clock::now();
+    long long serialHits = countInsideCircleSerial(N, seed);
+    double serialSec = chrono::duration<double>(clock::now() - t0).count();
+
+    Xoshiro256StarStar scalarRng = makeStream(seed, 0);
+    t0 = clock::now();
+    long long scalarHits = countInsideCircle(scalarRng, N);
+    double scalarSec = chrono::duration<double>(clock::now() - t0).count();
+
+    PiLanes batchedRng(makeStream(seed, 0));
+    t0 = clock::now();
+    long long batchedHits = countInsideCircleBatched(batchedRng, N);
+    double batchedSec = chrono::duration<double>(clock::now() - t0).count();
+
+#if defined(__AVX512F__)
+    const char *isa = "AVX-512";
+#elif defined(__AVX2__)
+    const char *isa = "AVX2";
+#else
+    const char *isa = "scalar";
+#endif
+
+    std::cout << "original: pi = " << 4.0 * serialHits / N << ", "
+              << N / serialSec / 1e6 << " Msamples/s\n";
+    std::cout << "scalar  : pi = " << 4.0 * scalarHits / N << ", "
+              << N / scalarSec / 1e6 << " Msamples/s\n";
+    std::cout << "batched : pi = " << 4.0 * batchedHits / N << ", "
+              << N / batchedSec / 1e6 << " Msamples/s (" << isa << ")\n";
+    std::cout << "speedup over original: " << serialSec / batchedSec << "x, over scalar: "
+              << scalarSec / batchedSec << "x" << std::endl;
+}
+
+// Usage: EstimatorOfPi [--threads N] [--seed S] [--engine xoshiro|philox] [--simd] [--qmc [R]] [--vr]
+//                      [--abs H | --rel R] [--bench]
+// Without --threads the original single-threaded mt19937_64 loop is used.
+// --qmc uses R (default 16) scrambled Sobol replicates and prints the error.
+// --vr compares the variance-reduced estimators with the crude one.
+// --abs H / --rel R run the batched kernel in chunks until the 95% CI
+// half-width is at most H (or R * pi) instead of a fixed N.
+// --engine picks the generator of the threaded mode; the choice only selects
+// which template instance runs, the inner loop has no runtime switch.
+int main(int argc, char *argv[]) {
+    const long long N = 100000000;
+
+    unsigned nThreads = 0;
+    uint64_t seed = 12345;
+    bool batched = false;
+    bool philox = false;
+    bool qmc = false;
+    long long replicates = 16;
+    PrecisionTarget target;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) nThreads = static_cast<unsigned>(strtoul(argv[++a], nullptr, 10));
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) seed = strtoull(argv[++a], nullptr, 10);
+        else if (strcmp(argv[a], "--engine") == 0 && a + 1 < argc) philox = strcmp(argv[++a], "philox") == 0;
+        else if (strcmp(argv[a], "--simd") == 0) batched = true;
+        else if (strcmp(argv[a], "--qmc") == 0) {
+            qmc = true;
+            if (a + 1 < argc && argv[a + 1][0] != '-') replicates = strtoll(argv[++a], nullptr, 10);
+        }
+        else if (strcmp(argv[a], "--abs") == 0 && a + 1 < argc) target.absolute = strtod(argv[++a], nullptr);
+        else if (strcmp(argv[a], "--rel") == 0 && a + 1 < argc) target.relative = strtod(argv[++a], nullptr);
+        else if (strcmp(argv[a], "--vr") == 0) {
+            compareVarianceReduction(N / 10, nThreads, seed);
+            return 0;
         }
+        else if (strcmp(argv[a], "--bench") == 0) {
+            runBenchmark(N, seed);
+            return 0;
+        }
+    }
+
+    if (target.absolute > 0 || target.relative > 0) {
+        if (nThreads == 0) nThreads = max(1u, thread::hardware_concurrency());
+        SequentialResult pi = estimatePiToPrecision(target, nThreads, seed);
+        std::cout << "Estimated Pi = " << setprecision(10) << pi.estimate << " +- " << setprecision(3)
+                  << pi.halfWidth << (pi.converged ? "" : " (target not reached)") << "\n"
+                  << pi.samples << " samples in " << pi.batches << " chunks (" << pi.samplesDrawn
+                  << " drawn), " << pi.wallSeconds << " s on " << nThreads << " threads" << std::endl;
+        return 0;
     }
 
+    if (qmc) {
+        if (replicates < 1 || replicates > N) {
+            std::cerr << "usage: --qmc R needs 1 <= R <= " << N << " replicates" << std::endl;
+            return 1;
+        }
+        RunningStats pi = estimatePiRQMC(N, replicates, nThreads, seed);
+        std::cout << "Estimated Pi = " << setprecision(10) << pi.mean() << " +- " << setprecision(3) << pi.ciHalfWidth()
+                  << " (RQMC, " << replicates << " scrambled Sobol replicates, seed " << seed << ")" << std::endl;
+        return 0;
+    }
+
+    if (batched && nThreads == 0) nThreads = 1;
+    if (nThreads > 0) {
+        double piEstimate = (philox && !batched) ? estimatePiParallel<Philox4x32>(N, nThreads, seed)
+                                                 : estimatePiParallel<Xoshiro256StarStar>(N, nThreads, seed, batched);
+        std::cout << "Estimated Pi = " << piEstimate
+                  << " (" << nThreads << " threads, seed " << seed
+                  << (batched ? ", batched" : (philox ? ", philox" : "")) << ")" << std::endl;
+        return 0;
+    }
+
+    long long pointsInsideCircle = countInsideCircleSerial(N, seed);
+
     double piEstimate = 4.0 * (static_cast<double>(pointsInsideCircle) / static_cast<double>(N));
 
     std::cout << "Estimated Pi = " << piEstimate << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,113 @@
+// Kernels of the pi estimator: the original mt19937_64 loop, the scalar
+// stream kernel and the batched (SIMD) kernel. Shared by EstimatorOfPi.cpp
+// and the distributed mode (ParameterSweep/DistributedReplications.cpp).
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "../Common/RandomStreams.hpp"
+
+// The original estimator: one mt19937_64, two dist(rng) calls and a branch
+// per sample. Returns the number of the N points inside the circle.
+inline long long countInsideCircleSerial(long long N, std::uint64_t seed) {
+    //Initialize random generator and distribution
+    std::mt19937_64 rng (seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    long long pointsInsideCircle = 0;
+    for (long long i = 0; i < N; i++) {
+        double x = dist(rng);
+        double y = dist(rng);
+        if(x*x + y*y <= 1.0) {
+            pointsInsideCircle++;
+        }
+    }
+    return pointsInsideCircle;
+}
+
+// Count how many of n uniform points in [-1,1]^2 fall inside the unit circle.
+// Each worker thread runs this on its own stream; the count stays in a local
+// variable so there is no shared state in the inner loop. Engine is any
+// 64-bit generator (Xoshiro256StarStar, Philox4x32, std::mt19937_64).
+template <class Engine>
+long long countInsideCircle(Engine &rng, long long n) {
+    long long inside = 0;
+    for (long long i = 0; i < n; i++) {
+        double x = 2.0 * toUnitDouble(rng()) - 1.0;
+        double y = 2.0 * toUnitDouble(rng()) - 1.0;
+        if(x*x + y*y <= 1.0) {
+            inside++;
+        }
+    }
+    return inside;
+}
+
+// ---- Batched (SIMD) kernel ----
+// Uniforms are generated PI_BLOCK at a time by PI_LANES interleaved
+// xoshiro streams into separate x and y arrays (structure of arrays),
+// then the hit test runs over the arrays without branches.
+constexpr int PI_LANES = 8;
+constexpr long long PI_BLOCK = 512;    // x, y and raw bits together stay in L1
+using PiLanes = Xoshiro256StarStarLanes<PI_LANES>;
+
+// Samples per chunk of the chunked estimators (sequential stopping, the
+// distributed mode). Chunk k owns the PI_LANES streams k*PI_LANES ..
+// k*PI_LANES + PI_LANES-1, so its lanes do not overlap those of any other
+// chunk.
+constexpr long long PI_CHUNK = 1 << 22;
+
+// Number of i < n with xs[i]^2 + ys[i]^2 <= 1.
+inline long long countHits(const double *xs, const double *ys, long long n) {
+    long long hits = 0;
+    long long i = 0;
+#if defined(__AVX512F__)
+    const __m512d one = _mm512_set1_pd(1.0);
+    for (; i + 8 <= n; i += 8) {
+        __m512d x = _mm512_load_pd(xs + i);
+        __m512d y = _mm512_load_pd(ys + i);
+        __m512d r2 = _mm512_fmadd_pd(x, x, _mm512_mul_pd(y, y));
+        __mmask8 m = _mm512_cmp_pd_mask(r2, one, _CMP_LE_OQ);
+        hits += __builtin_popcount(static_cast<unsigned>(m));
+    }
+#elif defined(__AVX2__)
+    const __m256d one = _mm256_set1_pd(1.0);
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_load_pd(xs + i);
+        __m256d y = _mm256_load_pd(ys + i);
+        __m256d r2 = _mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y));
+        int m = _mm256_movemask_pd(_mm256_cmp_pd(r2, one, _CMP_LE_OQ));
+        hits += __builtin_popcount(static_cast<unsigned>(m));
+    }
+#endif
+    // Scalar fallback (and tail): the comparison result is added directly.
+    for (; i < n; i++) {
+        hits += (xs[i]*xs[i] + ys[i]*ys[i] <= 1.0);
+    }
+    return hits;
+}
+
+// Batched counterpart of countInsideCircle. It uses a different stream
+// layout and 52-bit uniforms, so its estimate differs from the scalar one
+// for the same seed but is just as reproducible.
+inline long long countInsideCircleBatched(PiLanes &rng, long long n) {
+    alignas(64) std::uint64_t bits[2 * PI_BLOCK];
+    alignas(64) double xs[PI_BLOCK];
+    alignas(64) double ys[PI_BLOCK];
+
+    long long inside = 0;
+    for (long long done = 0; done < n; done += PI_BLOCK) {
+        long long m = (n - done < PI_BLOCK) ? n - done : PI_BLOCK;
+        rng.fill(bits, 2 * PI_BLOCK);
+        for (long long i = 0; i < PI_BLOCK; i++) {
+            xs[i] = 2.0 * toUnitDouble52(bits[i]) - 1.0;
+            ys[i] = 2.0 * toUnitDouble52(bits[PI_BLOCK + i]) - 1.0;
+        }
+        inside += countHits(xs, ys, m);
+    }
+    return inside;
+}
@@ -0,0 +1,149 @@
+/************************************************************
+ * Distributed mode: the replications of one estimator spread
+ * over MPI ranks (and the threads of every rank).
+ *
+ *   pi        the batched pi estimator, in chunks of PI_CHUNK
+ *             samples; chunk k owns streams k*PI_LANES ..
+ *   compound  the batch compound Poisson Y(T) with Uniform(0,1)
+ *             jumps, in blocks of 4096 replications; block b uses
+ *             stream b, as simulateCompoundPoissonBatch does
+ *
+ * Blocks are divided into contiguous shares over the ranks,
+ * streams are derived from the global seed by block index, and
+ * the per-block accumulators are merged with a tree reduce along
+ * a fixed block tree (Common/Distributed.hpp). The printed
+ * aggregates (at full precision) are therefore identical on any
+ * number of ranks and threads, as long as all ranks run the same
+ * binary on the same instruction set.
+ *
+ * Compile example:
+ *   mpicxx -std=c++17 -O3 -march=native -pthread DistributedReplications.cpp -o distributed
+ * Run:
+ *   mpirun -n 4 ./distributed pi [--samples N] [--threads T] [--seed S]
+ *   mpirun -n 4 ./distributed compound [--reps N] [--lambda L] [--horizon T] [--threads T] [--seed S]
+ ************************************************************/
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/Distributed.hpp"
+#include "../Common/OnlineStats.hpp"
+#include "../Continuous-timeStochasticProcesses/PoissonProcess.hpp"
+#include "../MonteCarlo/EstimatorOfPi.hpp"
+
+// Hits and samples of the pi estimator. Integer counts, so any merge
+// order gives the same result.
+struct PiCount
+{
+    long long inside = 0;
+    long long samples = 0;
+
+    void merge(const PiCount &other)
+    {
+        inside += other.inside;
+        samples += other.samples;
+    }
+
+    double estimate() const { return samples > 0 ? 4.0 * static_cast<double>(inside) / static_cast<double>(samples) : 0.0; }
+
+    // Binomial standard error of the estimate.
+    double standardError() const
+    {
+        if (samples == 0) return 0.0;
+        double p = static_cast<double>(inside) / static_cast<double>(samples);
+        return 4.0 * std::sqrt(p * (1 - p) / static_cast<double>(samples));
+    }
+
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int)
+    {
+        ar &inside &samples;
+    }
+};
+
+constexpr long long COMPOUND_BLOCK = 4096;
+
+int main(int argc, char *argv[])
+{
+    MpiSession mpi(argc, argv);
+
+    std::string mode = argc > 1 ? argv[1] : "pi";
+    long long samples = 1LL << 30;
+    long long replications = 10000000;
+    double lambda = 1.0, horizon = 10.0;
+    unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::uint64_t seed = 12345;
+    for (int a = 2; a < argc; a++)
+    {
+        if (std::strcmp(argv[a], "--samples") == 0 && a + 1 < argc) samples = std::strtoll(argv[++a], nullptr, 10);
+        else if (std::strcmp(argv[a], "--reps") == 0 && a + 1 < argc) replications = std::strtoll(argv[++a], nullptr, 10);
+        else if (std::strcmp(argv[a], "--lambda") == 0 && a + 1 < argc) lambda = std::strtod(argv[++a], nullptr);
+        else if (std::strcmp(argv[a], "--horizon") == 0 && a + 1 < argc) horizon = std::strtod(argv[++a], nullptr);
+        else if (std::strcmp(argv[a], "--threads") == 0 && a + 1 < argc) nThreads = static_cast<unsigned>(std::strtoul(argv[++a], nullptr, 10));
+        else if (std::strcmp(argv[a], "--seed") == 0 && a + 1 < argc) seed = std::strtoull(argv[++a], nullptr, 10);
+    }
+    if (samples < 1 || replications < 1)
+    {
+        if (mpi.rank() == 0)
+            std::cerr << "usage: " << (samples < 1 ? "--samples" : "--reps") << " N needs N >= 1, got "
+                      << (samples < 1 ? samples : replications) << std::endl;
+        return 1;
+    }
+
+    double start = MPI_Wtime();
+    if (mode == "pi")
+    {
+        const long long nBlocks = (samples + PI_CHUNK - 1) / PI_CHUNK;
+        PiCount pi = runDistributed(PiCount(), nBlocks, seed, nThreads, [samples](long long b, Xoshiro256StarStar &rng, PiCount &count) {
+            PiLanes lanes(rng);
+            count.samples = std::min(PI_CHUNK, samples - b * PI_CHUNK);
+            count.inside = countInsideCircleBatched(lanes, count.samples);
+        }, PI_LANES);
+        double sec = MPI_Wtime() - start;
+        if (mpi.rank() == 0)
+        {
+            std::cout << "Estimated Pi = " << std::setprecision(17) << pi.estimate() << " +- " << std::setprecision(3)
+                      << 1.96 * pi.standardError() << " (" << pi.inside << " of " << pi.samples << " inside)\n"
+                      << nBlocks << " chunks on " << mpi.size() << " ranks x " << nThreads << " threads in " << sec
+                      << " s" << std::endl;
+        }
+    }
+    else if (mode == "compound")
+    {
+        const long long nBlocks = (replications + COMPOUND_BLOCK - 1) / COMPOUND_BLOCK;
+        const CompoundPoissonBatch empty{RunningStats(), Histogram(0.0, 20.0, 400), ControlVariateStats(lambda * horizon)};
+        const UniformJumps jumps{0.0, 1.0};
+        CompoundPoissonBatch batch = runDistributed(empty, nBlocks, seed, nThreads,
+                                                    [&](long long b, Xoshiro256StarStar &rng, CompoundPoissonBatch &out) {
+            long long reps = std::min(COMPOUND_BLOCK, replications - b * COMPOUND_BLOCK);
+            std::vector<long long> counts(static_cast<std::size_t>(reps));
+            std::vector<double> buffer(4096);
+            simulateCompoundPoissonBlock(lambda, horizon, reps, jumps, rng, counts, buffer, out.moments,
+                                         out.controlled, out.histogram);
+        });
+        double sec = MPI_Wtime() - start;
+        if (mpi.rank() == 0)
+        {
+            std::cout << std::setprecision(17) << "Y(T): mean " << batch.moments.mean() << ", variance "
+                      << batch.moments.variance() << "\n  control variate N(T): mean " << batch.controlled.mean()
+                      << " +- " << std::setprecision(3) << batch.controlled.ciHalfWidth() << " (plain +- "
+                      << batch.moments.ciHalfWidth() << "), median " << batch.histogram.quantile(0.5) << ", 99% "
+                      << batch.histogram.quantile(0.99) << "\n"
+                      << batch.moments.count() << " replications in " << nBlocks << " blocks on " << mpi.size()
+                      << " ranks x " << nThreads << " threads in " << sec << " s" << std::endl;
+        }
+    }
+    else
+    {
+        if (mpi.rank() == 0) std::cerr << "unknown mode '" << mode << "' (pi or compound)\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,484 @@
+/************************************************************
+ * Parameter sweeps over the native simulators.
+ *
+ * A grid file lists one sweep per line: a model, values for its
+ * parameters and the number of replications, e.g.
+ *
+ *   poisson lambda=0.5,1,2 T=10,1000 reps=200
+ *   walk    p=0.5,0.6 n=1000,10000000 level=100 reps=50
+ *   markov  matrix=chain.edges n=100000 reps=20
+ *   buffer  K=0:32:4 runLength=1000 reps=1000 out=buffer.trace
+ *
+ * A parameter takes a comma-separated list or an inclusive range
+ * lo:hi:step; parameters that are left out keep their default.
+ * Every sweep runs the product of its parameter values (the first
+ * parameter varying slowest) and every (point, replication) pair
+ * is one task. The tasks of all sweeps go to one work-stealing
+ * pool (Common/WorkStealingPool.hpp), so short and long runs
+ * balance over all cores. Task r of point i in sweep s uses
+ * stream i * reps + r of group s of the seed, and results are
+ * written in task order, so the output files and the summary do
+ * not depend on the number of threads.
+ *
+ * Every sweep writes a trace file (Common/TraceFile.hpp) with
+ * the columns point, replication, the model parameters and the
+ * model results; the printed summary gives the mean and 95% CI
+ * of the first result per point.
+ *
+ * Models:
+ *   poisson  homogeneous Poisson process: lambda, T
+ *            -> arrivals, lastArrival
+ *   walk     simple random walk (bit-parallel): p, n, level
+ *            -> final, max, min, hittingTime
+ *   markov   chain from an edge-list file (or the 3-state example
+ *            for matrix=example): matrix, x0, n
+ *            -> visits (to x0 after time 0), finalState
+ *   buffer   two-machine fluid buffer: lam, mu, r1, r2, K, runLength
+ *            -> rate
+ *
+ * --profile file writes the instrumentation summary of the run
+ * (Common/Instrumentation.hpp) as JSON, with one phase per model;
+ * the counts are only collected when built with
+ * -DSTOCHSIM_INSTRUMENT.
+ *
+ * Compile example:
+ *   g++ -std=c++17 -O3 -march=native -pthread ParameterSweep.cpp -o sweep
+ * Run:
+ *   ./sweep grid.txt [--threads T] [--seed S] [--profile run.json]
+ ************************************************************/
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "../Common/RandomStreams.hpp"
+#include "../Common/Instrumentation.hpp"
+#include "../Common/OnlineStats.hpp"
+#include "../Common/TraceFile.hpp"
+#include "../Common/WorkStealingPool.hpp"
+#include "../Continuous-timeStochasticProcesses/PoissonProcess.hpp"
+#include "../Discrete-timeStochasticProcesses/RandomWalks.hpp"
+#include "../Discrete-timeStochasticProcesses/MarkovChains.hpp"
+#include "../Discrete-Event Simulation/OnOffFluidModel.hpp"
+
+struct Sweep;
+
+struct SweepParameter
+{
+    std::string name;
+    double defaultValue;
+};
+
+// A simulator as the sweep sees it: named parameters and result columns,
+// run(sweep, parameters, rng, results) for one replication, and
+// check(sweep, parameters), which throws for a point run cannot handle.
+struct SweepModel
+{
+    std::string name;
+    std::vector<SweepParameter> parameters;
+    std::vector<TraceColumn> results;
+    std::function<void(const Sweep &, const double *, Xoshiro256StarStar &, double *)> run;
+    std::function<void(const Sweep &, const double *)> check;
+};
+
+// One line of the grid file.
+struct Sweep
+{
+    SweepModel model;
+    std::vector<std::vector<double>> values;   // per parameter
+    long long replications = 1;
+    std::string output;
+    std::vector<SparseAliasTransitions> matrices;   // markov only
+    std::vector<std::string> matrixNames;
+
+    long long points() const
+    {
+        long long n = 1;
+        for (const std::vector<double> &v : values) n *= static_cast<long long>(v.size());
+        return n;
+    }
+
+    long long tasks() const { return points() * replications; }
+
+    // Parameter values of point i; the last parameter varies fastest.
+    std::vector<double> point(long long i) const
+    {
+        std::vector<double> par(values.size());
+        for (std::size_t j = values.size(); j-- > 0;)
+        {
+            long long n = static_cast<long long>(values[j].size());
+            par[j] = values[j][static_cast<std::size_t>(i % n)];
+            i /= n;
+        }
+        return par;
+    }
+};
+
+// The 3-state chain of MarkovChains.cpp, as a sparse matrix.
+SparseAliasTransitions exampleMarkovChain()
+{
+    const double p[3][3] = {{0.2, 0.3, 0.5}, {0.0, 0.3, 0.7}, {0.5, 0.4, 0.1}};
+    std::vector<Transition> entries;
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            if (p[i][j] > 0) entries.push_back({i, j, p[i][j]});
+    }
+    return SparseAliasTransitions(3, std::move(entries));
+}
+
+// Throws "name must be <rule>, got value" unless 'ok'.
+void require(bool ok, const char *name, const std::string &rule, double value)
+{
+    if (!ok)
+    {
+        std::ostringstream message;
+        message << name << " must be " << rule << ", got " << std::setprecision(10) << value;
+        throw std::invalid_argument(message.str());
+    }
+}
+
+// The model called 'name'.
+SweepModel makeModel(const std::string &name)
+{
+    SweepModel m;
+    m.name = name;
+    if (name == "poisson")
+    {
+        m.parameters = {{"lambda", 1.0}, {"T", 100.0}};
+        m.results = {{"arrivals", TraceType::Int64}, {"lastArrival", TraceType::Float64}};
+        m.run = [](const Sweep &, const double *par, Xoshiro256StarStar &rng, double *out) {
+            std::vector<double> arrivals = simulateHomogeneousPoisson(par[0], par[1], rng, PoissonMethod::OrderStatistics);
+            out[0] = static_cast<double>(arrivals.size());
+            out[1] = arrivals.empty() ? 0.0 : arrivals.back();
+        };
+        m.check = [](const Sweep &, const double *par) {
+            require(par[0] > 0, "lambda", "positive", par[0]);
+            require(par[1] >= 0, "T", "non-negative", par[1]);
+        };
+    }
+    else if (name == "walk")
+    {
+        m.parameters = {{"p", 0.5}, {"n", 1000.0}, {"level", 10.0}};
+        m.results = {{"final", TraceType::Int64}, {"max", TraceType::Int64}, {"min", TraceType::Int64},
+                     {"hittingTime", TraceType::Int64}};
+        m.run = [](const Sweep &, const double *par, Xoshiro256StarStar &rng, double *out) {
+            WalkStats s = simRandomWalkStatsFast(par[0], std::llround(par[1]), std::llround(par[2]), rng);
+            out[0] = static_cast<double>(s.finalPosition);
+            out[1] = static_cast<double>(s.maxPosition);
+            out[2] = static_cast<double>(s.minPosition);
+            out[3] = static_cast<double>(s.hittingTime);
+        };
+        m.check = [](const Sweep &, const double *par) {
+            require(par[0] >= 0 && par[0] <= 1, "p", "in [0, 1]", par[0]);
+            require(par[1] >= 0, "n", "non-negative", par[1]);
+        };
+    }
+    else if (name == "markov")
+    {
+        m.parameters = {{"matrix", 0.0}, {"x0", 0.0}, {"n", 1000.0}};
+        m.results = {{"visits", TraceType::Int64}, {"finalState", TraceType::Int32}};
+        m.run = [](const Sweep &sweep, const double *par, Xoshiro256StarStar &rng, double *out) {
+            const SparseAliasTransitions &p = sweep.matrices[static_cast<std::size_t>(par[0])];
+            const int x0 = static_cast<int>(par[1]);
+            int state = x0;
+            long long visits = 0;
+            for (long long i = std::llround(par[2]); i > 0; i--)
+            {
+                state = p.next(state, rng);
+                visits += state == x0;
+            }
+            out[0] = static_cast<double>(visits);
+            out[1] = state;
+        };
+        m.check = [](const Sweep &sweep, const double *par) {
+            const SparseAliasTransitions &p = sweep.matrices[static_cast<std::size_t>(par[0])];
+            require(par[1] >= 0 && par[1] < p.size() && par[1] == std::floor(par[1]), "x0",
+                    "a state of chain " + sweep.matrixNames[static_cast<std::size_t>(par[0])], par[1]);
+            require(par[2] >= 0, "n", "non-negative", par[2]);
+        };
+    }
+    else if (name == "buffer")
+    {
+        m.parameters = {{"lam", 1.0}, {"mu", 1.0}, {"r1", 5.0}, {"r2", 2.0}, {"K", 4.0}, {"runLength", 1000.0}};
+        m.results = {{"rate", TraceType::Float64}};
+        m.run = [](const Sweep &, const double *par, Xoshiro256StarStar &rng, double *out) {
+            out[0] = simBuffer(FluidParameters{par[0], par[1], par[2], par[3], par[4]}, par[5], rng);
+        };
+        m.check = [](const Sweep &, const double *par) {
+            require(par[0] > 0, "lam", "positive", par[0]);
+            require(par[1] > 0, "mu", "positive", par[1]);
+            require(par[2] > 0, "r1", "positive", par[2]);
+            require(par[3] > 0, "r2", "positive", par[3]);
+            require(par[4] >= 0, "K", "non-negative", par[4]);
+            require(par[5] > 0, "runLength", "positive", par[5]);
+        };
+    }
+    else
+    {
+        throw std::invalid_argument("unknown model '" + name + "' (poisson, walk, markov or buffer)");
+    }
+    return m;
+}
+
+// "1,2,4" or "lo:hi:step" (inclusive).
+std::vector<double> parseValues(const std::string &text)
+{
+    std::vector<double> values;
+    std::size_t colon = text.find(':');
+    if (colon != std::string::npos)
+    {
+        std::size_t second = text.find(':', colon + 1);
+        if (second == std::string::npos) throw std::invalid_argument("range needs lo:hi:step, got '" + text + "'");
+        double lo = std::stod(text.substr(0, colon));
+        double hi = std::stod(text.substr(colon + 1, second - colon - 1));
+        double step = std::stod(text.substr(second + 1));
+        if (!(step > 0)) throw std::invalid_argument("range step must be positive in '" + text + "'");
+        // The count is rounded so that hi is included despite rounding.
+        long long n = static_cast<long long>(std::floor((hi - lo) / step + 1e-9)) + 1;
+        for (long long k = 0; k < n; k++) values.push_back(lo + static_cast<double>(k) * step);
+    }
+    else
+    {
+        std::istringstream in(text);
+        std::string item;
+        while (std::getline(in, item, ',')) values.push_back(std::stod(item));
+    }
+    if (values.empty()) throw std::invalid_argument("no values in '" + text + "'");
+    return values;
+}
+
+// Split a comma-separated list of words.
+std::vector<std::string> parseWords(const std::string &text)
+{
+    std::vector<std::string> words;
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) words.push_back(item);
+    return words;
+}
+
+std::vector<Sweep> readGrid(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open grid file '" + path + "'");
+
+    std::vector<Sweep> sweeps;
+    std::string line;
+    long long lineNr = 0;
+    while (std::getline(in, line))
+    {
+        lineNr++;
+        std::size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream fields(line);
+        std::string modelName;
+        if (!(fields >> modelName)) continue;
+
+        const std::string where = path + ":" + std::to_string(lineNr) + ": ";
+        try
+        {
+            sweeps.emplace_back();
+            Sweep &sweep = sweeps.back();
+            sweep.model = makeModel(modelName);
+            for (const SweepParameter &p : sweep.model.parameters) sweep.values.push_back({p.defaultValue});
+            sweep.output = "sweep" + std::to_string(sweeps.size() - 1) + "_" + modelName + ".trace";
+
+            std::string field;
+            while (fields >> field)
+            {
+                std::size_t eq = field.find('=');
+                if (eq == std::string::npos) throw std::invalid_argument("expected key=value, got '" + field + "'");
+                std::string key = field.substr(0, eq), value = field.substr(eq + 1);
+                if (key == "reps")
+                {
+                    sweep.replications = std::stoll(value);
+                    if (sweep.replications < 1) throw std::invalid_argument("reps must be positive");
+                    continue;
+                }
+                if (key == "out")
+                {
+                    sweep.output = value;
+                    continue;
+                }
+                std::size_t j = 0;
+                while (j < sweep.model.parameters.size() && sweep.model.parameters[j].name != key) j++;
+                if (j == sweep.model.parameters.size())
+                    throw std::invalid_argument("model " + modelName + " has no parameter '" + key + "'");
+                if (modelName == "markov" && key == "matrix")
+                {
+                    // Each file becomes one value of the parameter: its index.
+                    sweep.values[j].clear();
+                    for (const std::string &file : parseWords(value))
+                    {
+                        sweep.matrices.push_back(file == "example" ? exampleMarkovChain() : loadEdgeList(file));
+                        sweep.matrixNames.push_back(file);
+                        sweep.values[j].push_back(static_cast<double>(sweep.matrices.size() - 1));
+                    }
+                    continue;
+                }
+                sweep.values[j] = parseValues(value);
+            }
+            if (modelName == "markov")
+            {
+                if (sweep.matrices.empty())
+                {
+                    sweep.matrices.push_back(exampleMarkovChain());
+                    sweep.matrixNames.push_back("example");
+                }
+            }
+            // Check every point up front, so that bad values are reported
+            // here with their line rather than by a task.
+            for (long long i = 0; i < sweep.points(); i++)
+            {
+                std::vector<double> par = sweep.point(i);
+                sweep.model.check(sweep, par.data());
+            }
+        }
+        catch (const std::exception &e)
+        {
+            throw std::runtime_error(where + e.what());
+        }
+    }
+    return sweeps;
+}
+
+// Trace columns of a sweep: point, replication, parameters, results.
+std::vector<TraceColumn> sweepColumns(const Sweep &sweep)
+{
+    std::vector<TraceColumn> columns = {{"point", TraceType::Int32}, {"replication", TraceType::Int32}};
+    for (const SweepParameter &p : sweep.model.parameters) columns.push_back({p.name, TraceType::Float64});
+    columns.insert(columns.end(), sweep.model.results.begin(), sweep.model.results.end());
+    return columns;
+}
+
+std::string sweepParams(const Sweep &sweep)
+{
+    std::ostringstream out;
+    out << "model=" << sweep.model.name << "\n" << "reps=" << sweep.replications << "\n";
+    for (std::size_t m = 0; m < sweep.matrixNames.size(); m++) out << "matrix" << m << "=" << sweep.matrixNames[m] << "\n";
+    return out.str();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " grid-file [--threads T] [--seed S] [--profile file]\n";
+        return 1;
+    }
+    unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::uint64_t seed = 12345;
+    std::string profile;
+    for (int a = 2; a < argc; a++)
+    {
+        if (std::strcmp(argv[a], "--threads") == 0 && a + 1 < argc) nThreads = static_cast<unsigned>(std::strtoul(argv[++a], nullptr, 10));
+        else if (std::strcmp(argv[a], "--seed") == 0 && a + 1 < argc) seed = std::strtoull(argv[++a], nullptr, 10);
+        else if (std::strcmp(argv[a], "--profile") == 0 && a + 1 < argc) profile = argv[++a];
+    }
+    instrumentation::reset();
+
+    try
+    {
+        std::vector<Sweep> sweeps = readGrid(argv[1]);
+
+        // Streams and result slots for every task of every sweep; task k of
+        // the whole run is task k - first[s] of sweep s.
+        std::vector<long long> first(sweeps.size() + 1, 0);
+        std::vector<std::vector<Xoshiro256StarStar>> rng(sweeps.size());
+        std::vector<std::vector<double>> results(sweeps.size());
+        RandomStreams streams(seed);
+        for (std::size_t s = 0; s < sweeps.size(); s++)
+        {
+            STOCHSIM_PHASE("streams");
+            const long long n = sweeps[s].tasks();
+            first[s + 1] = first[s] + n;
+            rng[s] = streams.group(s).streams(0, static_cast<std::size_t>(n));
+            results[s].resize(static_cast<std::size_t>(n) * sweeps[s].model.results.size());
+        }
+
+        // An exception must not leave a worker thread: the first one is kept
+        // and rethrown once the pool has joined.
+        std::exception_ptr failure;
+        std::mutex failureLock;
+        auto t0 = std::chrono::steady_clock::now();
+        WorkStealingStats balance = runWorkStealing(first.back(), nThreads, [&](long long k, unsigned) {
+            try
+            {
+                std::size_t s = static_cast<std::size_t>(std::upper_bound(first.begin(), first.end(), k) - first.begin() - 1);
+                const Sweep &sweep = sweeps[s];
+                STOCHSIM_PHASE(sweep.model.name.c_str());
+                const long long local = k - first[s];
+                std::vector<double> par = sweep.point(local / sweep.replications);
+                sweep.model.run(sweep, par.data(), rng[s][local], &results[s][local * sweep.model.results.size()]);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(failureLock);
+                if (!failure) failure = std::current_exception();
+            }
+        });
+        if (failure) std::rethrow_exception(failure);
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        for (std::size_t s = 0; s < sweeps.size(); s++)
+        {
+            const Sweep &sweep = sweeps[s];
+            STOCHSIM_PHASE("trace output");
+            const std::size_t nResults = sweep.model.results.size();
+            TraceWriter trace(sweep.output, seed, sweepColumns(sweep), sweepParams(sweep));
+            std::vector<double> row;
+            std::cout << sweep.model.name << " -> " << sweep.output << "\n";
+            for (long long i = 0; i < sweep.points(); i++)
+            {
+                std::vector<double> par = sweep.point(i);
+                RunningStats summary;
+                for (long long r = 0; r < sweep.replications; r++)
+                {
+                    const double *out = &results[s][(i * sweep.replications + r) * nResults];
+                    row.assign({static_cast<double>(i), static_cast<double>(r)});
+                    row.insert(row.end(), par.begin(), par.end());
+                    row.insert(row.end(), out, out + nResults);
+                    trace.appendRowValues(row.data());
+                    summary.add(out[0]);
+                }
+                std::cout << " " << std::setprecision(10);
+                for (std::size_t j = 0; j < par.size(); j++) std::cout << " " << sweep.model.parameters[j].name << "=" << par[j];
+                std::cout << "  " << sweep.model.results[0].name << " " << std::setprecision(6) << summary.mean() << " +- "
+                          << std::setprecision(3) << summary.ciHalfWidth() << "\n";
+            }
+        }
+
+        long long busiest = *std::max_element(balance.executed.begin(), balance.executed.end());
+        long long idlest = *std::min_element(balance.executed.begin(), balance.executed.end());
+        std::cout << first.back() << " tasks on " << balance.executed.size() << " threads in " << std::setprecision(3)
+                  << sec << " s; " << balance.totalStolen() << " tasks moved in " << balance.steals
+                  << " steals, " << idlest << " to " << busiest << " tasks per thread\n";
+
+        if (!profile.empty())
+        {
+            std::ofstream out(profile);
+            if (!out) throw std::runtime_error("cannot write " + profile);
+            instrumentation::writeJson(out, argv[1]);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}